@@ -0,0 +1,295 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace regez::benchmarks
+{
+
+enum Counter
+{
+    counter_cycles = 0,
+    counter_instructions,
+    counter_branches,
+    counter_branch_misses,
+    counter_l1_accesses,
+    counter_l1_misses,
+    counter_llc_accesses,
+    counter_llc_misses,
+    _counter_max,
+};
+
+using counter_values = std::array<std::optional<double>, _counter_max>;
+
+// Hardware counters of the calling thread, read with perf_event_open on
+// Linux. Every counter is opened on its own: the ones the kernel or the
+// machine does not provide are missing, the others are scaled by the time
+// they were actually scheduled.
+class PerfCounters
+{
+  public:
+    PerfCounters() noexcept;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // False when no counter could be opened, only time is measured then
+    bool available() const noexcept;
+    void start() noexcept;
+    counter_values stop() noexcept;
+
+  private:
+    std::array<int, _counter_max> _fds;
+};
+
+#if defined(__linux__)
+
+inline PerfCounters::PerfCounters() noexcept : _fds()
+{
+    const auto cache = [](std::uint64_t level, std::uint64_t result)
+    {
+        return level | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    };
+    constexpr std::array<std::uint32_t, _counter_max> types = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+    };
+    const std::array<std::uint64_t, _counter_max> configs = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+        cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS),
+        cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_ACCESS),
+        cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    };
+    for (std::size_t c = 0; c < _counter_max; ++c)
+    {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = types[c];
+        attr.config = configs[c];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format =
+            PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        _fds[c] = static_cast<int>(
+            syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+}
+
+inline PerfCounters::~PerfCounters()
+{
+    for (const int fd : _fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+inline bool PerfCounters::available() const noexcept
+{
+    for (const int fd : _fds)
+    {
+        if (fd >= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void PerfCounters::start() noexcept
+{
+    for (const int fd : _fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+inline counter_values PerfCounters::stop() noexcept
+{
+    counter_values values = {};
+    for (const int fd : _fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (std::size_t c = 0; c < _counter_max; ++c)
+    {
+        // value, time enabled, time running
+        std::array<std::uint64_t, 3> read_values = {};
+        if (_fds[c] < 0
+            || read(_fds[c], read_values.data(), sizeof(read_values))
+                   != static_cast<ssize_t>(sizeof(read_values))
+            || read_values[2] == 0)
+        {
+            continue;
+        }
+        values[c] = static_cast<double>(read_values[0])
+                    * static_cast<double>(read_values[1])
+                    / static_cast<double>(read_values[2]);
+    }
+    return values;
+}
+
+#else
+
+inline PerfCounters::PerfCounters() noexcept : _fds()
+{
+    _fds.fill(-1);
+}
+
+inline PerfCounters::~PerfCounters()
+{
+}
+
+inline bool PerfCounters::available() const noexcept
+{
+    return false;
+}
+
+inline void PerfCounters::start() noexcept
+{
+}
+
+inline counter_values PerfCounters::stop() noexcept
+{
+    return {};
+}
+
+#endif
+
+// One engine run over one input class, averaged over its repetitions
+struct Measurement
+{
+    std::string engine;
+    std::string pattern;
+    std::string input;
+    std::size_t bytes;
+    double milliseconds;
+    counter_values counters;
+};
+
+// Runs f, which reads bytes bytes of input, repeats times under the
+// counters. The result of f is kept so that the run is not optimized away
+template <class F>
+Measurement measure(PerfCounters &counters, const std::string &engine,
+                    const std::string &pattern, const std::string &input,
+                    std::size_t bytes, std::size_t repeats, F &&f)
+{
+    static volatile std::size_t sink = 0;
+    sink = sink + f(); // Warm up the caches and the branch predictor
+    counters.start();
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < repeats; ++r)
+    {
+        sink = sink + f();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    counter_values values = counters.stop();
+    for (auto &value : values)
+    {
+        if (value)
+        {
+            *value /= static_cast<double>(repeats);
+        }
+    }
+    return {engine,
+            pattern,
+            input,
+            bytes,
+            std::chrono::duration<double, std::milli>(end - start).count()
+                / static_cast<double>(repeats),
+            values};
+}
+
+// Writes the measurements with the columns of benchmarks/plotting: Input
+// Size, Time in milliseconds and Type, then the counters per byte and the
+// miss rates. Missing counters leave their columns empty
+inline void write_csv(std::ostream &os,
+                      const std::vector<Measurement> &measurements)
+{
+    const auto ratio = [&os](const std::optional<double> &numerator,
+                             const std::optional<double> &denominator)
+    {
+        if (numerator && denominator && *denominator > 0)
+        {
+            os << *numerator / *denominator;
+        }
+    };
+    os << "Input Size,Time,Type,Engine,Pattern,Input,Cycles/Byte,"
+          "Instructions/Byte,Branch Miss Rate,L1 Miss Rate,LLC Miss Rate\n";
+    for (const Measurement &m : measurements)
+    {
+        const std::optional<double> bytes = static_cast<double>(m.bytes);
+        os << m.bytes << ',' << m.milliseconds << ",\"" << m.engine << ' '
+           << m.pattern << " on " << m.input << "\",\"" << m.engine
+           << "\",\"" << m.pattern << "\",\"" << m.input << "\",";
+        ratio(m.counters[counter_cycles], bytes);
+        os << ',';
+        ratio(m.counters[counter_instructions], bytes);
+        os << ',';
+        ratio(m.counters[counter_branch_misses], m.counters[counter_branches]);
+        os << ',';
+        ratio(m.counters[counter_l1_misses], m.counters[counter_l1_accesses]);
+        os << ',';
+        ratio(m.counters[counter_llc_misses],
+              m.counters[counter_llc_accesses]);
+        os << '\n';
+    }
+}
+
+} // namespace regez::benchmarks
@@ -0,0 +1,16 @@
+import pandas as pd
+
+
+class perf_counters_data:
+    """
+    This class loads the measurements of the benchmark target: time and
+    hardware counters of every engine on every input class. The Engine
+    column names the automaton each row ran.
+    """
+
+    # Where the benchmarks write it unless REGEZ_BENCHMARK_CSV says otherwise
+    path = 'regez_benchmark.csv'
+
+    @staticmethod
+    def load(path=path):
+        return pd.read_csv(path)
@@ -24,5 +24,140 @@
  *
  */
 
+#include "perf_counters.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <regez/lexer.hpp>
 #include <regez/regez.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <valfuzz/valfuzz.hpp>
+
+namespace
+{
+
+// Symbols drawn from the alphabet with a fixed seed
+std::string random_input(std::size_t size, std::string_view alphabet)
+{
+    std::string input(size, ' ');
+    std::uint32_t seed = 12345;
+    for (char &c : input)
+    {
+        seed = seed * 1664525 + 1013904223;
+        c = alphabet[(seed >> 8) % alphabet.size()];
+    }
+    return input;
+}
+
+// Label of the engine in the Engine column
+std::string engine_name(regez::Engine engine)
+{
+    switch (engine)
+    {
+    case regez::Engine::engine_literal:
+        return "literal trie";
+    case regez::Engine::engine_dfa:
+        return "dfa";
+    case regez::Engine::engine_counting_nfa:
+        return "counting nfa";
+    case regez::Engine::engine_nfa:
+        return "nfa";
+    default:
+        return "none";
+    }
+}
+
+} // namespace
+
+// Cycles and instructions per byte, branch and cache miss rates of every
+// engine on every input class, written as CSV for benchmarks/plotting to
+// the file named by REGEZ_BENCHMARK_CSV, regez_benchmark.csv by default
+BENCHMARK(regez_perf_counters, "regez hardware counters per engine")
+{
+    namespace bench = regez::benchmarks;
+    const regez::Vocabulary<char> vocab =
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_or, '|')
+            .set(regez::Operators::op_concat, '.')
+            .set(regez::Operators::op_any, '*')
+            .set(regez::Operators::op_one_or_more, '+')
+            .set(regez::Operators::op_open_group, '(')
+            .set(regez::Operators::op_close_group, ')')
+            .set(regez::Operators::op_escape, '\\')
+            .set(regez::Operators::op_open_repeat, '{')
+            .set(regez::Operators::op_close_repeat, '}')
+            .set(regez::Operators::op_repeat_sep, ',')
+            .set(regez::Operators::op_open_match, '[')
+            .set(regez::Operators::op_close_match, ']')
+            .set(regez::Operators::op_range, '-')
+            .set(regez::Operators::op_negate, '^');
+    constexpr std::size_t size = 1 << 16;
+    constexpr std::size_t repeats = 3;
+    const std::vector<std::pair<std::string, std::string>> inputs = {
+        {"binary", random_input(size, "ab")},
+        {"text", random_input(size, "abcdefghijklmnopqrstuvwxyz    ")},
+    };
+    // Every match of the input is searched for, so that the whole input is
+    // read. Each row is labelled with the engine the search runs, the DFA,
+    // the literal trie and the counting NFA in turn
+    const std::vector<std::string> patterns = {
+        "(a|b)*abb",
+        "[a-z]+ing",
+        "get|post|put",
+        "(a|b){2,8}c",
+    };
+
+    bench::PerfCounters counters;
+    if (!counters.available())
+    {
+        std::cout << "hardware counters unavailable, timing only\n";
+    }
+    std::vector<bench::Measurement> measurements;
+    for (const std::string &pattern : patterns)
+    {
+        const regez::Regex<std::string> regex(pattern, vocab);
+        auto context = regex.context();
+        const std::string engine =
+            engine_name(regex.engine(regez::MatchMode::match_anywhere));
+        for (const auto &[name, input] : inputs)
+        {
+            measurements.push_back(bench::measure(
+                counters, engine, pattern, name, size, repeats,
+                [&regex, &context, &input]
+                {
+                    return static_cast<std::size_t>(std::ranges::distance(
+                        regex.matches(std::string_view(input), context)));
+                }));
+        }
+    }
+
+    constexpr regez::VocabularyConstexpr<char> lexer_vocab(
+        {'|', '.', '*', '+', '(', ')', '\\', '{', '}', ',', '[', ']', '-',
+         '^'});
+    using lexer_type = regez::Lexer<std::string, 8, 3>;
+    const auto lexer = std::make_unique<lexer_type>(
+        std::array<lexer_type::rule_type, 3>{{{std::string("the"), 0},
+                                              {std::string("[a-z]+"), 1},
+                                              {std::string(" +"), 2}}},
+        lexer_vocab);
+    const std::string &text = inputs.back().second;
+    std::vector<regez::Token> tokens;
+    // The rules of a lexer always run on their shared DFA
+    measurements.push_back(bench::measure(
+        counters, "lexer dfa", "the|[a-z]+| +", "text", size, repeats,
+        [&lexer, &text, &tokens]
+        {
+            tokens.clear();
+            lexer->tokenize(text, std::back_inserter(tokens));
+            return tokens.size();
+        }));
+
+    const char *path = std::getenv("REGEZ_BENCHMARK_CSV");
+    std::ofstream csv(path != nullptr ? path : "regez_benchmark.csv");
+    bench::write_csv(csv, measurements);
+}
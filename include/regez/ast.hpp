@@ -0,0 +1,1569 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include <regez/char_class.hpp>
+#include <regez/constexpr_stack.hpp>
+#include <regez/constexpr_vector.hpp>
+#include <regez/operators.hpp>
+
+namespace regez
+{
+
+constexpr std::size_t no_class = std::numeric_limits<std::size_t>::max();
+constexpr std::size_t no_node = std::numeric_limits<std::size_t>::max();
+constexpr std::size_t repeat_unbounded =
+    std::numeric_limits<std::size_t>::max();
+
+// Bounds of a counted repetition {min,max}, max may be repeat_unbounded
+struct Counter
+{
+    std::size_t min;
+    std::size_t max;
+
+    constexpr bool operator==(const Counter &) const noexcept = default;
+};
+
+// Maps each token of a pattern to the operator it stands for, built once
+// from the vocabulary. Single byte tokens use a 256 entries table, other
+// tokens a sorted array. The tokens that only have a meaning inside a class
+// or a counted repetition are kept apart and compared by the parser.
+template <class T> class TokenClassifier
+{
+  public:
+    using value_type = T;
+    template <class Vocab>
+    constexpr explicit TokenClassifier(const Vocab &voc) noexcept;
+    // Returns _op_max for terminal symbols. Operators the vocabulary leaves
+    // out are never returned, their tokens are terminal symbols
+    constexpr Operators classify(const T &token) const noexcept;
+    constexpr const T &get(const Operators op) const noexcept
+    {
+        return _tokens[op];
+    }
+    // Whether token is the one of op, which the vocabulary gives
+    constexpr bool is(const T &token, const Operators op) const noexcept
+    {
+        return _defined[op] && token == _tokens[op];
+    }
+
+  private:
+    constexpr static bool has_table = sizeof(T) == 1 && std::is_integral_v<T>;
+    // Operators that can appear anywhere in the pattern, by priority
+    constexpr static std::array<Operators, 9> structural = {
+        Operators::op_escape,      Operators::op_open_group,
+        Operators::op_close_group, Operators::op_open_match,
+        Operators::op_open_repeat, Operators::op_any,
+        Operators::op_one_or_more, Operators::op_or,
+        Operators::op_concat};
+    constexpr static std::size_t byte(const T &token) noexcept
+    {
+        return static_cast<std::size_t>(static_cast<unsigned char>(token));
+    }
+    std::array<T, Operators::_op_max> _tokens;
+    std::array<bool, Operators::_op_max> _defined;
+    std::array<Operators, has_table ? 256 : 0> _table;
+    std::array<std::pair<T, Operators>, structural.size()> _sorted;
+    std::size_t _sorted_size;
+};
+
+template <class T>
+template <class Vocab>
+constexpr TokenClassifier<T>::TokenClassifier(const Vocab &voc) noexcept
+    : _tokens(), _defined(), _table(), _sorted(), _sorted_size(0)
+{
+    for (std::size_t op = 0; op < Operators::_op_max; ++op)
+    {
+        _tokens[op] = voc.get(static_cast<Operators>(op));
+        _defined[op] = voc.has(static_cast<Operators>(op));
+    }
+    if constexpr (has_table)
+    {
+        _table.fill(Operators::_op_max);
+        for (std::size_t i = structural.size(); i > 0; --i)
+        {
+            if (_defined[structural[i - 1]])
+            {
+                _table[byte(_tokens[structural[i - 1]])] = structural[i - 1];
+            }
+        }
+    }
+    else
+    {
+        // Insertion sort by token, the first operator wins on duplicates
+        for (const auto &op : structural)
+        {
+            if (!_defined[op])
+            {
+                continue;
+            }
+            bool duplicate = false;
+            for (std::size_t i = 0; i < _sorted_size; ++i)
+            {
+                duplicate = duplicate || _sorted[i].first == _tokens[op];
+            }
+            if (duplicate)
+            {
+                continue;
+            }
+            std::size_t i = _sorted_size;
+            if constexpr (std::totally_ordered<T>)
+            {
+                for (; i > 0 && _tokens[op] < _sorted[i - 1].first; --i)
+                {
+                    _sorted[i] = _sorted[i - 1];
+                }
+            }
+            _sorted[i] = std::make_pair(_tokens[op], op);
+            ++_sorted_size;
+        }
+    }
+}
+
+template <class T>
+constexpr Operators TokenClassifier<T>::classify(const T &token) const noexcept
+{
+    if constexpr (has_table)
+    {
+        return _table[byte(token)];
+    }
+    else if constexpr (std::totally_ordered<T>)
+    {
+        std::size_t lo = 0;
+        std::size_t hi = _sorted_size;
+        while (lo < hi)
+        {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (_sorted[mid].first < token)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return (lo < _sorted_size && _sorted[lo].first == token)
+                   ? _sorted[lo].second
+                   : Operators::_op_max;
+    }
+    else
+    {
+        for (std::size_t i = 0; i < _sorted_size; ++i)
+        {
+            if (_sorted[i].first == token)
+            {
+                return _sorted[i].second;
+            }
+        }
+        return Operators::_op_max;
+    }
+}
+
+// How the elements of a pattern and of its inputs are read as symbols
+enum Encoding
+{
+    encoding_symbols = 0, // every element is a symbol
+    encoding_utf8,        // single byte elements hold UTF-8, a code point is
+                          // matched as the sequence of its bytes
+};
+
+enum NodeKind
+{
+    node_empty = 0,   // matches the empty sequence
+    node_symbol,      // a single symbol
+    node_class,       // a character class
+    node_concat,      // children one after the other
+    node_or,          // any of the children
+    node_any,         // child*
+    node_one_or_more, // child+
+    node_repeat,      // child{min,max}
+};
+
+template <class T> struct AstNode
+{
+    NodeKind kind;
+    T symbol;
+    std::size_t char_class;
+    Counter bounds;
+    std::size_t first_child;
+    std::size_t next_sibling;
+};
+
+// Syntax tree of a pattern. Nodes and classes live in fixed pools and refer
+// to each other by index, children are linked through next_sibling.
+template <class T, std::size_t N> class Ast
+{
+  public:
+    using value_type = T;
+    // Every member of a class takes a token of the pattern, so does every
+    // symbol that simplification merges into a class
+    constexpr static std::size_t max_class_ranges = N;
+    using char_class_type = CharClass<T, max_class_ranges>;
+    // Parsing takes at most two nodes per token, simplification may need
+    // as many again
+    constexpr static std::size_t max_nodes = 4 * N + 4;
+    constexpr static std::size_t max_classes = N / 2 + 1;
+
+    constexpr explicit Ast() noexcept;
+    // Encodings other than encoding_symbols only apply to single byte
+    // integral symbols
+    template <class Container>
+    constexpr static Ast
+    from_infix(const Container &pattern, const TokenClassifier<T> &classifier,
+               Encoding encoding = Encoding::encoding_symbols) noexcept;
+    constexpr static Ast
+    from_postfix(const ConstexprVector<T, N> &rpn,
+                 const TokenClassifier<T> &classifier) noexcept;
+    constexpr void simplify() noexcept;
+    constexpr ConstexprVector<T, N>
+    to_postfix(const TokenClassifier<T> &classifier) const noexcept;
+
+    constexpr bool valid() const noexcept
+    {
+        return !_error && _root != no_node;
+    }
+    constexpr std::size_t root() const noexcept
+    {
+        return _root;
+    }
+    constexpr const AstNode<T> &node(const std::size_t id) const noexcept
+    {
+        return _nodes[id];
+    }
+    constexpr const char_class_type &
+    char_class(const std::size_t id) const noexcept
+    {
+        return _classes[id];
+    }
+    constexpr std::size_t size() const noexcept;
+    constexpr bool has(const NodeKind kind) const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    std::array<AstNode<T>, max_nodes> _nodes;
+    std::size_t _n_nodes;
+    std::array<char_class_type, max_classes> _classes;
+    std::size_t _n_classes;
+    std::size_t _root;
+    bool _error;
+    bool _utf8;
+
+    constexpr std::size_t new_node(NodeKind kind, T symbol = T()) noexcept;
+    constexpr std::size_t new_class(const char_class_type &cls) noexcept;
+    constexpr void append_child(std::size_t parent, std::size_t child) noexcept;
+    constexpr std::size_t unary(NodeKind kind, std::size_t child) noexcept;
+
+    // Parser, recursive descent over the tokens of the pattern
+    constexpr std::size_t
+    parse_or(const ConstexprVector<T, N> &tokens, std::size_t &i,
+             const TokenClassifier<T> &classifier) noexcept;
+    constexpr std::size_t
+    parse_concat(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                 const TokenClassifier<T> &classifier) noexcept;
+    constexpr std::size_t
+    parse_postfix(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                  const TokenClassifier<T> &classifier) noexcept;
+    constexpr std::size_t
+    parse_atom(const ConstexprVector<T, N> &tokens, std::size_t &i,
+               const TokenClassifier<T> &classifier) noexcept;
+    constexpr std::size_t
+    parse_class(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                const TokenClassifier<T> &classifier) noexcept;
+    // False when the bounds are not closed, not decimal or out of order
+    constexpr static bool
+    parse_repeat(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                 const TokenClassifier<T> &classifier,
+                 Counter &bounds) noexcept;
+
+    // UTF-8: a code point becomes the concatenation of its bytes and a class
+    // the alternation of the byte sequences of its code points, as long as
+    // the nodes that take states stay within N
+    constexpr static bool has_utf8 = sizeof(T) == 1 && std::is_integral_v<T>;
+    using code_point_class_type = CharClass<char32_t, max_class_ranges>;
+    constexpr static bool decode_utf8(const ConstexprVector<T, N> &tokens,
+                                      std::size_t &i,
+                                      char32_t &point) noexcept;
+    constexpr static std::size_t
+    encode_utf8(char32_t point, std::array<unsigned char, 4> &bytes) noexcept;
+    constexpr std::size_t utf8_symbol(const ConstexprVector<T, N> &tokens,
+                                      std::size_t &i) noexcept;
+    constexpr std::size_t utf8_class(const code_point_class_type &points,
+                                     bool negated) noexcept;
+    constexpr std::size_t utf8_sequence(char32_t lo, char32_t hi) noexcept;
+    constexpr std::size_t weight() const noexcept;
+
+    // Rewrite passes
+    constexpr std::size_t simplify(std::size_t id) noexcept;
+    constexpr void flatten(std::size_t id) noexcept;
+    constexpr void factor_prefixes(std::size_t id) noexcept;
+    constexpr void merge_classes(std::size_t id) noexcept;
+    constexpr bool equal(std::size_t a, std::size_t b) const noexcept;
+
+    constexpr void emit(std::size_t id, ConstexprVector<T, N> &postfix,
+                        const TokenClassifier<T> &classifier) const noexcept;
+    constexpr static void emit_symbol(const T &symbol,
+                                      ConstexprVector<T, N> &postfix,
+                                      const TokenClassifier<T> &classifier,
+                                      bool in_class) noexcept;
+    constexpr static void emit_number(std::size_t value,
+                                      ConstexprVector<T, N> &postfix) noexcept;
+};
+
+template <class T, std::size_t N>
+constexpr Ast<T, N>::Ast() noexcept
+    : _nodes(), _n_nodes(0), _classes(), _n_classes(0), _root(no_node),
+      _error(false), _utf8(false)
+{
+}
+
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::new_node(NodeKind kind, T symbol) noexcept
+{
+    if (_n_nodes == max_nodes)
+    {
+        _error = true;
+        return no_node;
+    }
+    _nodes[_n_nodes] = AstNode<T>{kind,    symbol,  no_class,
+                                  {1, 1}, no_node, no_node};
+    return _n_nodes++;
+}
+
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::new_class(const char_class_type &cls) noexcept
+{
+    if (_n_classes == max_classes)
+    {
+        _error = true;
+        return no_class;
+    }
+    _classes[_n_classes] = cls;
+    return _n_classes++;
+}
+
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::append_child(std::size_t parent,
+                                       std::size_t child) noexcept
+{
+    if (parent == no_node || child == no_node)
+    {
+        _error = true;
+        return;
+    }
+    _nodes[child].next_sibling = no_node;
+    std::size_t *link = &_nodes[parent].first_child;
+    while (*link != no_node)
+    {
+        link = &_nodes[*link].next_sibling;
+    }
+    *link = child;
+}
+
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::unary(NodeKind kind,
+                                       std::size_t child) noexcept
+{
+    std::size_t id = new_node(kind);
+    append_child(id, child);
+    return id;
+}
+
+// Counts the nodes reachable from the root
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::size() const noexcept
+{
+    if (!valid())
+    {
+        return 0;
+    }
+    std::size_t count = 0;
+    ConstexprStack<std::size_t, max_nodes> work;
+    work.push(_root);
+    while (!work.empty())
+    {
+        std::size_t id = work.top();
+        work.pop();
+        ++count;
+        for (std::size_t c = _nodes[id].first_child; c != no_node;
+             c = _nodes[c].next_sibling)
+        {
+            work.push(c);
+        }
+    }
+    return count;
+}
+
+template <class T, std::size_t N>
+constexpr bool Ast<T, N>::has(const NodeKind kind) const noexcept
+{
+    if (!valid())
+    {
+        return false;
+    }
+    ConstexprStack<std::size_t, max_nodes> work;
+    work.push(_root);
+    while (!work.empty())
+    {
+        std::size_t id = work.top();
+        work.pop();
+        if (_nodes[id].kind == kind)
+        {
+            return true;
+        }
+        for (std::size_t c = _nodes[id].first_child; c != no_node;
+             c = _nodes[c].next_sibling)
+        {
+            work.push(c);
+        }
+    }
+    return false;
+}
+
+template <class T, std::size_t N>
+template <class Container>
+constexpr Ast<T, N>
+Ast<T, N>::from_infix(const Container &pattern,
+                      const TokenClassifier<T> &classifier,
+                      const Encoding encoding) noexcept
+{
+    Ast ast;
+    ast._utf8 = has_utf8 && encoding == Encoding::encoding_utf8;
+    ConstexprVector<T, N> tokens;
+    for (const auto &c : pattern)
+    {
+        tokens.push_back(c);
+    }
+    std::size_t i = 0;
+    ast._root = ast.parse_or(tokens, i, classifier);
+    if (i != tokens.size()) // Unbalanced group
+    {
+        ast._error = true;
+    }
+    // Every token gives at most one node that takes states, byte sequences
+    // may give more
+    if (ast._utf8 && ast.weight() > N)
+    {
+        ast._error = true;
+    }
+    return ast;
+}
+
+// or := concat ('|' concat)*
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::parse_or(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                    const TokenClassifier<T> &classifier) noexcept
+{
+    std::size_t first = parse_concat(tokens, i, classifier);
+    if (i >= tokens.size()
+        || classifier.classify(tokens[i]) != Operators::op_or)
+    {
+        return first;
+    }
+    std::size_t id = new_node(NodeKind::node_or);
+    append_child(id, first);
+    while (i < tokens.size()
+           && classifier.classify(tokens[i]) == Operators::op_or)
+    {
+        ++i;
+        append_child(id, parse_concat(tokens, i, classifier));
+    }
+    return id;
+}
+
+// concat := postfix ('.'? postfix)*, juxtaposed operands are concatenated
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::parse_concat(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                        const TokenClassifier<T> &classifier) noexcept
+{
+    std::size_t first = parse_postfix(tokens, i, classifier);
+    std::size_t id = no_node;
+    // An atom in error may not have moved past its token
+    while (i < tokens.size() && !_error)
+    {
+        Operators op = classifier.classify(tokens[i]);
+        if (op == Operators::op_or || op == Operators::op_close_group)
+        {
+            break;
+        }
+        if (op == Operators::op_concat)
+        {
+            ++i;
+        }
+        if (id == no_node)
+        {
+            id = new_node(NodeKind::node_concat);
+            append_child(id, first);
+        }
+        append_child(id, parse_postfix(tokens, i, classifier));
+    }
+    return id == no_node ? first : id;
+}
+
+// postfix := atom ('*' | '+' | '{m,n}')*
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::parse_postfix(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                         const TokenClassifier<T> &classifier) noexcept
+{
+    std::size_t id = parse_atom(tokens, i, classifier);
+    while (i < tokens.size())
+    {
+        Operators op = classifier.classify(tokens[i]);
+        if (op == Operators::op_any)
+        {
+            id = unary(NodeKind::node_any, id);
+            ++i;
+        }
+        else if (op == Operators::op_one_or_more)
+        {
+            id = unary(NodeKind::node_one_or_more, id);
+            ++i;
+        }
+        else if (op == Operators::op_open_repeat)
+        {
+            Counter bounds = {};
+            if (!parse_repeat(tokens, i, classifier, bounds))
+            {
+                _error = true;
+                break;
+            }
+            id = unary(NodeKind::node_repeat, id);
+            if (id != no_node)
+            {
+                _nodes[id].bounds = bounds;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+    return id;
+}
+
+// atom := '(' or ')' | '[' class ']' | '\' symbol | symbol
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::parse_atom(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                      const TokenClassifier<T> &classifier) noexcept
+{
+    if (i >= tokens.size()) // Missing operand
+    {
+        _error = true;
+        return no_node;
+    }
+    switch (classifier.classify(tokens[i]))
+    {
+    case Operators::op_open_group:
+    {
+        ++i;
+        std::size_t id = parse_or(tokens, i, classifier);
+        if (i >= tokens.size()
+            || classifier.classify(tokens[i]) != Operators::op_close_group)
+        {
+            _error = true;
+            return id;
+        }
+        ++i;
+        return id;
+    }
+    case Operators::op_open_match:
+        return parse_class(tokens, i, classifier);
+    case Operators::op_escape:
+        if (i + 1 >= tokens.size())
+        {
+            _error = true;
+            return no_node;
+        }
+        ++i;
+        [[fallthrough]];
+    case Operators::_op_max:
+        if constexpr (has_utf8)
+        {
+            if (_utf8 && static_cast<unsigned char>(tokens[i]) >= 0x80)
+            {
+                return utf8_symbol(tokens, i);
+            }
+        }
+        ++i;
+        return new_node(NodeKind::node_symbol, tokens[i - 1]);
+    default: // Operator without operand
+        _error = true;
+        return no_node;
+    }
+}
+
+// Reads the character class starting at tokens[i], eg. [a-zA-Z_] or [^0-9]
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::parse_class(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                       const TokenClassifier<T> &classifier) noexcept
+{
+    char_class_type cls;
+    // The same members as code points, in UTF-8
+    code_point_class_type points;
+    char32_t last_point = 0;
+    bool has_symbol = false;
+    bool is_range = false;
+    bool closed = false;
+    T last = T();
+    ++i;
+    if (i < tokens.size() && classifier.is(tokens[i], Operators::op_negate))
+    {
+        cls.negate();
+        ++i;
+    }
+    for (; i < tokens.size(); ++i)
+    {
+        T s = tokens[i];
+        if (classifier.is(s, Operators::op_close_match))
+        {
+            closed = true;
+            ++i;
+            break;
+        }
+        if (classifier.is(s, Operators::op_range) && has_symbol && !is_range)
+        {
+            is_range = true;
+            continue;
+        }
+        if (classifier.is(s, Operators::op_escape) && i + 1 < tokens.size())
+        {
+            s = tokens[++i];
+        }
+        char32_t point = 0;
+        if constexpr (has_utf8)
+        {
+            if (_utf8 && !decode_utf8(tokens, i, point))
+            {
+                _error = true;
+                return no_node;
+            }
+        }
+        if (is_range)
+        {
+            cls.add_range(last, s);
+            points.add_range(last_point, point);
+            is_range = false;
+            has_symbol = false;
+        }
+        else
+        {
+            cls.add(s);
+            points.add(point);
+            last = s;
+            last_point = point;
+            has_symbol = true;
+        }
+    }
+    if (is_range) // A trailing range token is a member of the class
+    {
+        cls.add(classifier.get(Operators::op_range));
+        if constexpr (has_utf8)
+        {
+            points.add(static_cast<unsigned char>(
+                classifier.get(Operators::op_range)));
+        }
+    }
+    if (!closed)
+    {
+        _error = true;
+    }
+    // Classes of ASCII symbols read single bytes as they are
+    if (_utf8
+        && (cls.negated()
+            || (points.size() != 0
+                && points[points.size() - 1].second >= 0x80)))
+    {
+        return utf8_class(points, cls.negated());
+    }
+    std::size_t id = new_node(NodeKind::node_class);
+    if (id != no_node)
+    {
+        _nodes[id].char_class = new_class(cls);
+    }
+    return id;
+}
+
+// Reads the bounds of the counted repetition starting at tokens[i], written
+// as {m}, {m,}, {,n} or {m,n} with decimal digits
+template <class T, std::size_t N>
+constexpr bool
+Ast<T, N>::parse_repeat(const ConstexprVector<T, N> &tokens, std::size_t &i,
+                        const TokenClassifier<T> &classifier,
+                        Counter &bounds) noexcept
+{
+    std::size_t value = 0;
+    bool has_value = false;
+    bool has_sep = false;
+    bool closed = false;
+    bounds = {0, repeat_unbounded};
+    for (++i; i < tokens.size(); ++i)
+    {
+        T s = tokens[i];
+        if (classifier.is(s, Operators::op_close_repeat))
+        {
+            ++i;
+            closed = true;
+            break;
+        }
+        if (classifier.is(s, Operators::op_repeat_sep) && !has_sep)
+        {
+            bounds.min = value;
+            has_sep = true;
+            has_value = false;
+            value = 0;
+            continue;
+        }
+        if constexpr (std::is_integral_v<T>)
+        {
+            // Past this a bound could not be counted anyway
+            constexpr std::size_t max_bound =
+                std::numeric_limits<std::size_t>::max() / 10 - 9;
+            if (s < T('0') || s > T('9') || value > max_bound)
+            {
+                return false;
+            }
+            value = value * 10 + static_cast<std::size_t>(s - T('0'));
+            has_value = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (!closed || (!has_sep && !has_value))
+    {
+        return false;
+    }
+    if (!has_sep)
+    {
+        bounds.min = value;
+        bounds.max = value;
+    }
+    else if (has_value)
+    {
+        bounds.max = value;
+    }
+    return bounds.max == repeat_unbounded || bounds.min <= bounds.max;
+}
+
+// Reads the code point whose first byte is tokens[i], leaving i on its last
+// byte. Fails on malformed, overlong and surrogate encodings
+template <class T, std::size_t N>
+constexpr bool Ast<T, N>::decode_utf8(const ConstexprVector<T, N> &tokens,
+                                      std::size_t &i,
+                                      char32_t &point) noexcept
+{
+    constexpr std::array<char32_t, 5> min_point = {0, 0, 0x80, 0x800,
+                                                    0x10000};
+    const auto lead = static_cast<unsigned char>(tokens[i]);
+    const std::size_t length = lead < 0x80   ? 1
+                               : lead < 0xc2 ? 0
+                               : lead < 0xe0 ? 2
+                               : lead < 0xf0 ? 3
+                               : lead < 0xf5 ? 4
+                                             : 0;
+    if (length == 0 || i + length > tokens.size())
+    {
+        return false;
+    }
+    point = length == 1 ? lead : lead & (0x7f >> length);
+    for (std::size_t k = 1; k < length; ++k)
+    {
+        const auto byte = static_cast<unsigned char>(tokens[i + k]);
+        if ((byte & 0xc0) != 0x80)
+        {
+            return false;
+        }
+        point = point << 6 | (byte & 0x3f);
+    }
+    if (point < min_point[length] || point > 0x10ffff
+        || (point >= 0xd800 && point <= 0xdfff))
+    {
+        return false;
+    }
+    i += length - 1;
+    return true;
+}
+
+// Writes the bytes of a code point, returns how many
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::encode_utf8(const char32_t point,
+                       std::array<unsigned char, 4> &bytes) noexcept
+{
+    if (point < 0x80)
+    {
+        bytes[0] = static_cast<unsigned char>(point);
+        return 1;
+    }
+    const std::size_t length = point < 0x800 ? 2 : point < 0x10000 ? 3 : 4;
+    constexpr std::array<unsigned char, 5> lead = {0, 0, 0xc0, 0xe0, 0xf0};
+    for (std::size_t k = length - 1; k > 0; --k)
+    {
+        bytes[k] = static_cast<unsigned char>(
+            0x80 | (point >> (6 * (length - 1 - k)) & 0x3f));
+    }
+    bytes[0] = static_cast<unsigned char>(lead[length]
+                                          | point >> (6 * (length - 1)));
+    return length;
+}
+
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::utf8_symbol(const ConstexprVector<T, N> &tokens,
+                       std::size_t &i) noexcept
+{
+    const std::size_t first = i;
+    char32_t point = 0;
+    if (!decode_utf8(tokens, i, point))
+    {
+        _error = true;
+        ++i;
+        return no_node;
+    }
+    const std::size_t id = new_node(NodeKind::node_concat);
+    for (std::size_t k = first; k <= i; ++k)
+    {
+        append_child(id, new_node(NodeKind::node_symbol, tokens[k]));
+    }
+    ++i;
+    return id;
+}
+
+// The code points of the class, or of its complement, are split into
+// ranges whose encodings share their length and in which every byte but
+// the first spans whole ranges of continuation bytes, so that each range is
+// a sequence of byte ranges
+template <class T, std::size_t N>
+constexpr std::size_t
+Ast<T, N>::utf8_class(const code_point_class_type &points,
+                      const bool negated) noexcept
+{
+    using range_type = std::pair<char32_t, char32_t>;
+    const std::size_t id = new_node(NodeKind::node_or);
+    // Each range is split on its own, which leaves a few pieces to do at
+    // any time however many ranges the class has
+    const auto split_range = [this, id](const char32_t first,
+                                        const char32_t last)
+    {
+        ConstexprStack<range_type, 32> work;
+        work.push({first, last});
+        while (!work.empty())
+        {
+            const auto [lo, hi] = work.top();
+            work.pop();
+            bool split = false;
+            constexpr std::array<char32_t, 3> last_of_length = {0x7f, 0x7ff,
+                                                                0xffff};
+            for (const char32_t max : last_of_length)
+            {
+                if (!split && lo <= max && hi > max)
+                {
+                    work.push({max + 1, hi});
+                    work.push({lo, max});
+                    split = true;
+                }
+            }
+            for (std::size_t k = 1; k < 4 && !split; ++k)
+            {
+                const char32_t mask = (char32_t(1) << (6 * k)) - 1;
+                if ((lo & ~mask) == (hi & ~mask))
+                {
+                    continue;
+                }
+                if ((lo & mask) != 0)
+                {
+                    work.push({(lo | mask) + 1, hi});
+                    work.push({lo, lo | mask});
+                    split = true;
+                }
+                else if ((hi & mask) != mask)
+                {
+                    work.push({hi & ~mask, hi});
+                    work.push({lo, (hi & ~mask) - 1});
+                    split = true;
+                }
+            }
+            if (!split)
+            {
+                append_child(id, utf8_sequence(lo, hi));
+            }
+        }
+    };
+    // UTF-8 does not encode the surrogates
+    const auto add = [&split_range](const char32_t lo, const char32_t hi)
+    {
+        if (lo <= 0xd7ff)
+        {
+            split_range(lo, hi < 0xd7ff ? hi : 0xd7ff);
+        }
+        if (hi >= 0xe000)
+        {
+            split_range(lo > 0xe000 ? lo : 0xe000, hi);
+        }
+    };
+    char32_t from = 0;
+    for (std::size_t r = 0; r < points.size(); ++r)
+    {
+        if (!negated)
+        {
+            add(points[r].first, points[r].second);
+        }
+        else if (points[r].first > from)
+        {
+            add(from, points[r].first - 1);
+        }
+        from = points[r].second + 1;
+    }
+    if (negated && from <= 0x10ffff)
+    {
+        add(from, 0x10ffff);
+    }
+
+    // An empty class matches nothing
+    if (id != no_node && _nodes[id].first_child == no_node)
+    {
+        const std::size_t empty = new_node(NodeKind::node_class);
+        if (empty != no_node)
+        {
+            _nodes[empty].char_class = new_class(char_class_type());
+        }
+        append_child(id, empty);
+    }
+    return id;
+}
+
+// Bytes of the code points from lo to hi, which are encoded with the same
+// length and differ in ranges of whole bytes
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::utf8_sequence(const char32_t lo,
+                                               const char32_t hi) noexcept
+{
+    std::array<unsigned char, 4> lo_bytes = {};
+    std::array<unsigned char, 4> hi_bytes = {};
+    const std::size_t length = encode_utf8(lo, lo_bytes);
+    encode_utf8(hi, hi_bytes);
+    const std::size_t id =
+        length == 1 ? no_node : new_node(NodeKind::node_concat);
+    std::size_t byte = no_node;
+    for (std::size_t k = 0; k < length; ++k)
+    {
+        if (lo_bytes[k] == hi_bytes[k])
+        {
+            byte = new_node(NodeKind::node_symbol,
+                            static_cast<T>(lo_bytes[k]));
+        }
+        else
+        {
+            char_class_type cls;
+            cls.add_range(static_cast<T>(lo_bytes[k]),
+                          static_cast<T>(hi_bytes[k]));
+            byte = new_node(NodeKind::node_class);
+            if (byte != no_node)
+            {
+                _nodes[byte].char_class = new_class(cls);
+            }
+        }
+        if (length > 1)
+        {
+            append_child(id, byte);
+        }
+    }
+    return length == 1 ? byte : id;
+}
+
+// Nodes reachable from the root that take states in an automaton
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::weight() const noexcept
+{
+    if (!valid())
+    {
+        return 0;
+    }
+    std::size_t count = 0;
+    ConstexprStack<std::size_t, max_nodes> work;
+    work.push(_root);
+    while (!work.empty())
+    {
+        std::size_t id = work.top();
+        work.pop();
+        count += _nodes[id].kind != NodeKind::node_concat;
+        for (std::size_t c = _nodes[id].first_child; c != no_node;
+             c = _nodes[c].next_sibling)
+        {
+            work.push(c);
+        }
+    }
+    return count;
+}
+
+// Builds the tree of a postfix pattern, as produced by to_postfix
+template <class T, std::size_t N>
+constexpr Ast<T, N>
+Ast<T, N>::from_postfix(const ConstexprVector<T, N> &rpn,
+                        const TokenClassifier<T> &classifier) noexcept
+{
+    Ast ast;
+    ConstexprStack<std::size_t, N> operands;
+    for (std::size_t i = 0; i < rpn.size() && !ast._error;)
+    {
+        Operators op = classifier.classify(rpn[i]);
+        if (op == Operators::op_or || op == Operators::op_concat)
+        {
+            if (operands.size() < 2) // Not enough operands
+            {
+                ast._error = true;
+                break;
+            }
+            std::size_t right = operands.top();
+            operands.pop();
+            std::size_t left = operands.top();
+            operands.pop();
+            std::size_t id = ast.new_node(op == Operators::op_or
+                                              ? NodeKind::node_or
+                                              : NodeKind::node_concat);
+            ast.append_child(id, left);
+            ast.append_child(id, right);
+            operands.push(id);
+            ++i;
+        }
+        else if (op == Operators::op_any || op == Operators::op_one_or_more
+                 || op == Operators::op_open_repeat)
+        {
+            if (operands.empty()) // Not enough operands
+            {
+                ast._error = true;
+                break;
+            }
+            std::size_t operand = operands.top();
+            operands.pop();
+            std::size_t id = no_node;
+            if (op == Operators::op_open_repeat)
+            {
+                Counter bounds = {};
+                if (!parse_repeat(rpn, i, classifier, bounds))
+                {
+                    ast._error = true;
+                    break;
+                }
+                id = ast.unary(NodeKind::node_repeat, operand);
+                if (id != no_node)
+                {
+                    ast._nodes[id].bounds = bounds;
+                }
+            }
+            else
+            {
+                id = ast.unary(op == Operators::op_any
+                                   ? NodeKind::node_any
+                                   : NodeKind::node_one_or_more,
+                               operand);
+                ++i;
+            }
+            operands.push(id);
+        }
+        else
+        {
+            operands.push(ast.parse_atom(rpn, i, classifier));
+        }
+    }
+    if (operands.size() != 1)
+    {
+        ast._error = true;
+        return ast;
+    }
+    ast._root = operands.top();
+    return ast;
+}
+
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::simplify() noexcept
+{
+    if (valid())
+    {
+        _root = simplify(_root);
+    }
+    if (_utf8 && weight() > N)
+    {
+        _error = true;
+    }
+}
+
+// Simplifies the subtree rooted in id bottom up, returns its new root
+template <class T, std::size_t N>
+constexpr std::size_t Ast<T, N>::simplify(std::size_t id) noexcept
+{
+    // Children first, the list is rebuilt with the simplified roots
+    std::size_t child = _nodes[id].first_child;
+    _nodes[id].first_child = no_node;
+    while (child != no_node)
+    {
+        std::size_t next = _nodes[child].next_sibling;
+        append_child(id, simplify(child));
+        child = next;
+    }
+
+    AstNode<T> &node = _nodes[id];
+    switch (node.kind)
+    {
+    case NodeKind::node_concat:
+        flatten(id);
+        break;
+    case NodeKind::node_or:
+        flatten(id);
+        factor_prefixes(id);
+        merge_classes(id);
+        break;
+    case NodeKind::node_any:
+    case NodeKind::node_one_or_more:
+    {
+        // (x*)* (x+)* (x*)+ are x*, (x+)+ is x+
+        AstNode<T> &operand = _nodes[node.first_child];
+        if (operand.kind == NodeKind::node_any
+            || operand.kind == NodeKind::node_one_or_more)
+        {
+            if (node.kind == NodeKind::node_any)
+            {
+                operand.kind = NodeKind::node_any;
+            }
+            return node.first_child;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+
+    // Operators left with a single operand
+    if ((node.kind == NodeKind::node_concat || node.kind == NodeKind::node_or)
+        && node.first_child != no_node
+        && _nodes[node.first_child].next_sibling == no_node)
+    {
+        return node.first_child;
+    }
+    return id;
+}
+
+// Splices the children of nested operators of the same kind: (ab)c is abc
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::flatten(std::size_t id) noexcept
+{
+    std::size_t child = _nodes[id].first_child;
+    _nodes[id].first_child = no_node;
+    while (child != no_node)
+    {
+        std::size_t next = _nodes[child].next_sibling;
+        if (_nodes[child].kind == _nodes[id].kind)
+        {
+            std::size_t grandchild = _nodes[child].first_child;
+            while (grandchild != no_node)
+            {
+                std::size_t next_grandchild = _nodes[grandchild].next_sibling;
+                append_child(id, grandchild);
+                grandchild = next_grandchild;
+            }
+        }
+        else
+        {
+            append_child(id, child);
+        }
+        child = next;
+    }
+}
+
+// Alternatives that start the same way share their prefix: abc|abd is
+// ab(c|d). Identical alternatives are dropped
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::factor_prefixes(std::size_t id) noexcept
+{
+    ConstexprVector<std::size_t, N> alternatives;
+    for (std::size_t c = _nodes[id].first_child; c != no_node;
+         c = _nodes[c].next_sibling)
+    {
+        bool duplicate = false;
+        for (const auto &a : alternatives)
+        {
+            duplicate = duplicate || equal(a, c);
+        }
+        if (!duplicate)
+        {
+            alternatives.push_back(c);
+        }
+    }
+
+    _nodes[id].first_child = no_node;
+    ConstexprVector<bool, N> done;
+    for (std::size_t i = 0; i < alternatives.size(); ++i)
+    {
+        done.push_back(false);
+    }
+    for (std::size_t i = 0; i < alternatives.size(); ++i)
+    {
+        if (done[i])
+        {
+            continue;
+        }
+        const std::size_t alternative = alternatives[i];
+        const bool is_concat =
+            _nodes[alternative].kind == NodeKind::node_concat;
+        const std::size_t head =
+            is_concat ? _nodes[alternative].first_child : alternative;
+
+        const auto head_of = [this](std::size_t other)
+        {
+            return _nodes[other].kind == NodeKind::node_concat
+                       ? _nodes[other].first_child
+                       : other;
+        };
+        // What follows a shared head: nothing, or the rest of a concatenation
+        // starting at tail. A full pool gives no_node, which append_child()
+        // turns into an error
+        const auto suffix_of = [this](std::size_t tail)
+        {
+            const std::size_t suffix =
+                new_node(tail == no_node ? NodeKind::node_empty
+                                         : NodeKind::node_concat);
+            if (suffix != no_node && tail != no_node)
+            {
+                _nodes[suffix].first_child = tail;
+            }
+            return suffix;
+        };
+        // Factoring takes a node per alternative plus three, the pattern is
+        // left as it is when the pool cannot hold them
+        std::size_t sharing = 0;
+        for (std::size_t j = i + 1; j < alternatives.size(); ++j)
+        {
+            if (!done[j] && equal(head, head_of(alternatives[j])))
+            {
+                ++sharing;
+            }
+        }
+        if (_n_nodes + sharing + 4 > max_nodes)
+        {
+            sharing = 0;
+        }
+
+        std::size_t rest = no_node;
+        for (std::size_t j = i + 1; j < alternatives.size() && sharing > 0;
+             ++j)
+        {
+            const std::size_t other = alternatives[j];
+            const std::size_t other_head = head_of(other);
+            if (done[j] || !equal(head, other_head))
+            {
+                continue;
+            }
+            if (rest == no_node)
+            {
+                rest = new_node(NodeKind::node_or);
+                append_child(rest, suffix_of(is_concat
+                                                 ? _nodes[head].next_sibling
+                                                 : no_node));
+            }
+            append_child(rest, suffix_of(other == other_head
+                                             ? no_node
+                                             : _nodes[other_head].next_sibling));
+            done[j] = true;
+        }
+
+        if (rest == no_node || _error)
+        {
+            append_child(id, alternative);
+            continue;
+        }
+        // head (rest), the alternatives of rest may share prefixes as well
+        std::size_t factored = new_node(NodeKind::node_concat);
+        append_child(factored, head);
+        append_child(factored, simplify(rest));
+        append_child(id, simplify(factored));
+    }
+}
+
+// Alternatives that are single symbols or classes become one class:
+// a|b|[0-9] is [ab0-9]
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::merge_classes(std::size_t id) noexcept
+{
+    if constexpr (std::totally_ordered<T>)
+    {
+        std::size_t mergeable = 0;
+        for (std::size_t c = _nodes[id].first_child; c != no_node;
+             c = _nodes[c].next_sibling)
+        {
+            const AstNode<T> &node = _nodes[c];
+            mergeable += node.kind == NodeKind::node_symbol
+                         || (node.kind == NodeKind::node_class
+                             && !_classes[node.char_class].negated());
+        }
+        if (mergeable < 2 || _n_classes == max_classes)
+        {
+            return;
+        }
+
+        char_class_type cls;
+        std::size_t merged = no_node;
+        std::size_t child = _nodes[id].first_child;
+        _nodes[id].first_child = no_node;
+        while (child != no_node)
+        {
+            std::size_t next = _nodes[child].next_sibling;
+            const AstNode<T> &node = _nodes[child];
+            if (node.kind == NodeKind::node_symbol)
+            {
+                cls.add(node.symbol);
+            }
+            else if (node.kind == NodeKind::node_class
+                     && !_classes[node.char_class].negated())
+            {
+                const char_class_type &members = _classes[node.char_class];
+                for (std::size_t r = 0; r < members.size(); ++r)
+                {
+                    cls.add_range(members[r].first, members[r].second);
+                }
+            }
+            else
+            {
+                append_child(id, child);
+                child = next;
+                continue;
+            }
+            if (merged == no_node) // Takes the place of the first member
+            {
+                merged = child;
+                append_child(id, merged);
+            }
+            child = next;
+        }
+        _nodes[merged].kind = NodeKind::node_class;
+        _nodes[merged].first_child = no_node;
+        _nodes[merged].char_class = new_class(cls);
+    }
+}
+
+// Structural equality of two subtrees
+template <class T, std::size_t N>
+constexpr bool Ast<T, N>::equal(std::size_t a, std::size_t b) const noexcept
+{
+    const AstNode<T> &x = _nodes[a];
+    const AstNode<T> &y = _nodes[b];
+    if (x.kind != y.kind)
+    {
+        return false;
+    }
+    switch (x.kind)
+    {
+    case NodeKind::node_empty:
+        return true;
+    case NodeKind::node_symbol:
+        return x.symbol == y.symbol;
+    case NodeKind::node_class:
+    {
+        const char_class_type &cx = _classes[x.char_class];
+        const char_class_type &cy = _classes[y.char_class];
+        if (cx.size() != cy.size() || cx.negated() != cy.negated())
+        {
+            return false;
+        }
+        for (std::size_t r = 0; r < cx.size(); ++r)
+        {
+            if (!(cx[r].first == cy[r].first)
+                || !(cx[r].second == cy[r].second))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case NodeKind::node_repeat:
+        if (!(x.bounds == y.bounds))
+        {
+            return false;
+        }
+        [[fallthrough]];
+    default:
+    {
+        std::size_t cx = x.first_child;
+        std::size_t cy = y.first_child;
+        while (cx != no_node && cy != no_node)
+        {
+            if (!equal(cx, cy))
+            {
+                return false;
+            }
+            cx = _nodes[cx].next_sibling;
+            cy = _nodes[cy].next_sibling;
+        }
+        return cx == no_node && cy == no_node;
+    }
+    }
+}
+
+template <class T, std::size_t N>
+constexpr ConstexprVector<T, N>
+Ast<T, N>::to_postfix(const TokenClassifier<T> &classifier) const noexcept
+{
+    ConstexprVector<T, N> postfix;
+    if (valid())
+    {
+        emit(_root, postfix, classifier);
+    }
+    return postfix;
+}
+
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::emit(std::size_t id, ConstexprVector<T, N> &postfix,
+                               const TokenClassifier<T> &classifier) const
+    noexcept
+{
+    const AstNode<T> &node = _nodes[id];
+    switch (node.kind)
+    {
+    case NodeKind::node_empty:
+        break;
+    case NodeKind::node_symbol:
+        emit_symbol(node.symbol, postfix, classifier, false);
+        break;
+    case NodeKind::node_class:
+    {
+        const char_class_type &cls = _classes[node.char_class];
+        postfix.push_back(classifier.get(Operators::op_open_match));
+        if (cls.negated())
+        {
+            postfix.push_back(classifier.get(Operators::op_negate));
+        }
+        for (std::size_t r = 0; r < cls.size(); ++r)
+        {
+            emit_symbol(cls[r].first, postfix, classifier, true);
+            if (!(cls[r].first == cls[r].second))
+            {
+                postfix.push_back(classifier.get(Operators::op_range));
+                emit_symbol(cls[r].second, postfix, classifier, true);
+            }
+        }
+        postfix.push_back(classifier.get(Operators::op_close_match));
+        break;
+    }
+    case NodeKind::node_concat:
+    case NodeKind::node_or:
+    {
+        // n-ary operators are written left associative: a b . c .
+        const Operators op = node.kind == NodeKind::node_concat
+                                 ? Operators::op_concat
+                                 : Operators::op_or;
+        for (std::size_t c = node.first_child; c != no_node;
+             c = _nodes[c].next_sibling)
+        {
+            emit(c, postfix, classifier);
+            if (c != node.first_child)
+            {
+                postfix.push_back(classifier.get(op));
+            }
+        }
+        break;
+    }
+    case NodeKind::node_any:
+        emit(node.first_child, postfix, classifier);
+        postfix.push_back(classifier.get(Operators::op_any));
+        break;
+    case NodeKind::node_one_or_more:
+        emit(node.first_child, postfix, classifier);
+        postfix.push_back(classifier.get(Operators::op_one_or_more));
+        break;
+    case NodeKind::node_repeat:
+        emit(node.first_child, postfix, classifier);
+        postfix.push_back(classifier.get(Operators::op_open_repeat));
+        if (node.bounds.min != 0 || node.bounds.max == node.bounds.min)
+        {
+            emit_number(node.bounds.min, postfix);
+        }
+        if (node.bounds.max != node.bounds.min)
+        {
+            postfix.push_back(classifier.get(Operators::op_repeat_sep));
+            if (node.bounds.max != repeat_unbounded)
+            {
+                emit_number(node.bounds.max, postfix);
+            }
+        }
+        postfix.push_back(classifier.get(Operators::op_close_repeat));
+        break;
+    }
+}
+
+// Writes a symbol, escaping it when it would be read as an operator
+template <class T, std::size_t N>
+constexpr void Ast<T, N>::emit_symbol(const T &symbol,
+                                      ConstexprVector<T, N> &postfix,
+                                      const TokenClassifier<T> &classifier,
+                                      bool in_class) noexcept
+{
+    const bool is_operator =
+        in_class ? (classifier.is(symbol, Operators::op_close_match)
+                    || classifier.is(symbol, Operators::op_range)
+                    || classifier.is(symbol, Operators::op_escape))
+                 : classifier.classify(symbol) != Operators::_op_max;
+    if (is_operator)
+    {
+        postfix.push_back(classifier.get(Operators::op_escape));
+    }
+    postfix.push_back(symbol);
+}
+
+template <class T, std::size_t N>
+constexpr void
+Ast<T, N>::emit_number(std::size_t value,
+                       ConstexprVector<T, N> &postfix) noexcept
+{
+    if constexpr (std::is_integral_v<T>)
+    {
+        std::size_t magnitude = 1;
+        while (value / magnitude >= 10)
+        {
+            magnitude *= 10;
+        }
+        for (; magnitude > 0; magnitude /= 10)
+        {
+            postfix.push_back(
+                static_cast<T>(T('0')
+                               + static_cast<T>(value / magnitude % 10)));
+        }
+    }
+}
+
+} // namespace regez
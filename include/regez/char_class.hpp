@@ -0,0 +1,192 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace regez
+{
+
+// A set of symbols stored as sorted, non overlapping ranges. Single byte
+// symbols are also stored in a 256-bit bitmap so that testing a symbol
+// costs one lookup.
+template <class T, std::size_t N> class CharClass
+{
+  public:
+    using value_type = T;
+    using range_type = std::pair<T, T>;
+    constexpr explicit CharClass() noexcept;
+    constexpr void add(const T &symbol) noexcept;
+    constexpr void add_range(const T &lo, const T &hi) noexcept;
+    constexpr void negate() noexcept;
+    constexpr bool contains(const T &symbol) const noexcept;
+    constexpr bool negated() const noexcept
+    {
+        return m_negated;
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return m_size;
+    }
+    constexpr const range_type &operator[](const std::size_t index) const
+        noexcept
+    {
+        return m_ranges[index];
+    }
+
+  private:
+    constexpr static bool has_bitmap = sizeof(T) == 1 && std::is_integral_v<T>;
+    constexpr static std::size_t bit(const T &symbol) noexcept
+    {
+        return static_cast<std::size_t>(static_cast<unsigned char>(symbol));
+    }
+    // Whether b immediately follows a, so that [x,a] and [b,y] can be merged
+    constexpr static bool adjacent(const T &a, const T &b) noexcept
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return a < std::numeric_limits<T>::max() && T(a + 1) == b;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    std::size_t m_size;
+    bool m_negated;
+    std::array<range_type, N> m_ranges;
+    std::array<std::uint64_t, 4> m_bitmap;
+};
+
+template <class T, std::size_t N>
+constexpr CharClass<T, N>::CharClass() noexcept
+    : m_size(0), m_negated(false), m_ranges(), m_bitmap()
+{
+}
+
+template <class T, std::size_t N>
+constexpr void CharClass<T, N>::add(const T &symbol) noexcept
+{
+    add_range(symbol, symbol);
+}
+
+// Inserts the range keeping the ranges sorted, merging the ones that overlap
+template <class T, std::size_t N>
+constexpr void CharClass<T, N>::add_range(const T &_lo, const T &_hi) noexcept
+{
+    T lo = _lo < _hi ? _lo : _hi;
+    T hi = _lo < _hi ? _hi : _lo;
+    if constexpr (has_bitmap)
+    {
+        for (T symbol = lo;; ++symbol)
+        {
+            m_bitmap[bit(symbol) / 64] |= std::uint64_t(1)
+                                          << (bit(symbol) % 64);
+            if (symbol == hi)
+            {
+                break;
+            }
+        }
+    }
+
+    std::size_t i = 0;
+    while (i < m_size && m_ranges[i].second < lo
+           && !adjacent(m_ranges[i].second, lo))
+    {
+        ++i;
+    }
+    std::size_t j = i;
+    while (j < m_size
+           && (!(hi < m_ranges[j].first) || adjacent(hi, m_ranges[j].first)))
+    {
+        lo = m_ranges[j].first < lo ? m_ranges[j].first : lo;
+        hi = hi < m_ranges[j].second ? m_ranges[j].second : hi;
+        ++j;
+    }
+    if (i == j) // Nothing to merge, make room for the new range
+    {
+        if (m_size == N)
+        {
+            return;
+        }
+        for (std::size_t k = m_size; k > i; --k)
+        {
+            m_ranges[k] = m_ranges[k - 1];
+        }
+        ++m_size;
+    }
+    else // Ranges i..j-1 collapse into one
+    {
+        for (std::size_t k = 0; j + k < m_size; ++k)
+        {
+            m_ranges[i + 1 + k] = m_ranges[j + k];
+        }
+        m_size -= j - i - 1;
+    }
+    m_ranges[i] = range_type(lo, hi);
+}
+
+template <class T, std::size_t N>
+constexpr void CharClass<T, N>::negate() noexcept
+{
+    m_negated = !m_negated;
+}
+
+template <class T, std::size_t N>
+constexpr bool CharClass<T, N>::contains(const T &symbol) const noexcept
+{
+    if constexpr (has_bitmap)
+    {
+        const std::size_t b = bit(symbol);
+        return ((m_bitmap[b / 64] >> (b % 64)) & 1) != m_negated;
+    }
+    else
+    {
+        std::size_t lo = 0;
+        std::size_t hi = m_size;
+        while (lo < hi)
+        {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (m_ranges[mid].second < symbol)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        const bool found = lo < m_size && !(symbol < m_ranges[lo].first);
+        return found != m_negated;
+    }
+}
+
+} // namespace regez
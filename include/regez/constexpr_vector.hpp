@@ -42,7 +42,8 @@ template <typename T, std::size_t N> class ConstexprVector
     constexpr std::size_t size() const noexcept;
     constexpr bool empty() const noexcept;
     constexpr bool contains(const T &value) const noexcept;
-    constexpr T operator[](const std::size_t index) const noexcept;
+    constexpr T &operator[](const std::size_t index) noexcept;
+    constexpr const T &operator[](const std::size_t index) const noexcept;
     constexpr std::array<T, N>::const_iterator begin() const noexcept
     {
         return m_data.begin();
@@ -113,7 +114,13 @@ constexpr bool ConstexprVector<T, N>::contains(const T &value) const noexcept
 }
 
 template <typename T, std::size_t N>
-constexpr T
+constexpr T &ConstexprVector<T, N>::operator[](const std::size_t index) noexcept
+{
+    return m_data[index];
+}
+
+template <typename T, std::size_t N>
+constexpr const T &
 ConstexprVector<T, N>::operator[](const std::size_t index) const noexcept
 {
     return m_data[index];
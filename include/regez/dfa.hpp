@@ -0,0 +1,878 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <regez/ast.hpp>
+#include <regez/constexpr_stack.hpp>
+#include <regez/dfa_table.hpp>
+#include <regez/memory_usage.hpp>
+#include <type_traits>
+#include <vector>
+
+namespace regez
+{
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L> struct DfaHeatmap;
+
+// Deterministic automaton obtained from an NFA by subset construction. S is
+// the maximum number of states and A the maximum number of symbol classes.
+//
+// Symbols that no transition of the NFA tells apart share a class, so a row
+// of the transition table has one entry per class instead of one per symbol.
+// Classes are the intervals between sorted bounds; single byte symbols are
+// mapped to their class with a 256 entry table.
+//
+// State 0 is the dead state: it is not accepting and every transition loops
+// on it, every state that cannot lead to an accepting one is merged into it.
+// Only integral symbols and NFAs without counters are supported,
+// build() returns false otherwise or when more than S states are needed.
+//
+// L selects how the table is stored, see DfaLayout. A compressed table that
+// does not fit makes build() fail as well.
+template <class T, std::size_t S, std::size_t A,
+          DfaLayout L = default_dfa_layout>
+class Dfa
+{
+  public:
+    using value_type = T;
+    using state_type = std::uint32_t;
+    constexpr static state_type dead_state = 0;
+
+    constexpr explicit Dfa() noexcept;
+    // An unanchored automaton may start a match at every position, as if the
+    // pattern was prefixed by any symbol repeated, until one is found. It
+    // then only follows the threads of the leftmost match, so its first
+    // accepting state ends the match that ends first and its last one before
+    // dying ends the longest of the leftmost matches. When given, accepted
+    // receives for every accepting state the position in the final states
+    // of the NFA of the first one it contains
+    template <class Nfa>
+    constexpr bool
+    build(const Nfa &nfa, bool unanchored,
+          std::array<std::size_t, S> *accepted = nullptr) noexcept;
+    constexpr bool valid() const noexcept
+    {
+        return _n_states != 0;
+    }
+    // Whether the last build() found the automaton but could not fit its
+    // table in the layout
+    constexpr bool overflowed() const noexcept
+    {
+        return _overflowed;
+    }
+    constexpr state_type initial() const noexcept
+    {
+        return 1;
+    }
+    constexpr state_type next(const state_type state,
+                              const T &symbol) const noexcept
+    {
+        return _table.at(state, classify(symbol));
+    }
+    constexpr bool accepting(const state_type state) const noexcept
+    {
+        return _accepting[state];
+    }
+    constexpr bool dead(const state_type state) const noexcept
+    {
+        return state == dead_state;
+    }
+    // Every input read from this state is accepted
+    constexpr bool always_accepting(const state_type state) const noexcept
+    {
+        return _always_accepting[state];
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return _n_states;
+    }
+    constexpr std::size_t classes() const noexcept
+    {
+        return _n_classes;
+    }
+    constexpr std::size_t classify(const T &symbol) const noexcept;
+
+    // Number of times each state was entered on sample inputs
+    using profile_type = std::array<std::size_t, S>;
+    // Runs the automaton on a sample input, adding its visits to the profile
+    template <class It, class Sentinel>
+    constexpr void profile(It first, Sentinel last,
+                           profile_type &visits) const noexcept;
+    // Renumbers the states by decreasing number of visits, so that the rows
+    // of the hottest states are contiguous at the start of the table. The
+    // dead and initial states keep their numbers
+    constexpr void relayout(const profile_type &visits) noexcept;
+    // Binary image of the automaton, to be loaded back by an automaton of
+    // the same type. load() leaves the automaton unchanged on failure
+    bool save(std::ostream &os) const;
+    bool load(std::istream &is);
+    // Same automaton up to the numbering of its states
+    constexpr bool isomorphic(const Dfa &other) const noexcept;
+    constexpr MemorySize memory_usage() const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    template <class U, std::size_t S2, std::size_t A2, DfaLayout L2>
+    friend std::ostream &operator<<(std::ostream &os,
+                                    const DfaHeatmap<U, S2, A2, L2> &heatmap);
+
+    constexpr static bool has_byte_map =
+        sizeof(T) == 1 && std::is_integral_v<T>;
+
+    std::size_t _n_states;
+    std::size_t _n_classes;
+    // Lower bound of every class, sorted
+    std::array<T, A> _bounds;
+    std::array<std::uint8_t, 256> _byte_classes;
+    using table_type = std::conditional_t<L == DfaLayout::dfa_dense,
+                                          DenseTable<S, A>,
+                                          CompressedTable<S, A>>;
+    using rows_type = table_type::rows_type;
+    table_type _table;
+    std::array<bool, S> _accepting;
+    std::array<bool, S> _always_accepting;
+    bool _overflowed;
+
+    constexpr static std::uint32_t magic = 0x5a464144; // "DAFZ"
+
+    constexpr bool add_bound(const T &bound) noexcept;
+    constexpr void prune(rows_type &rows) noexcept;
+    constexpr void mark_always_accepting(const rows_type &rows) noexcept;
+    constexpr std::size_t search(const T &symbol) const noexcept;
+};
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr Dfa<T, S, A, L>::Dfa() noexcept
+    : _n_states(0), _n_classes(0), _bounds(), _byte_classes(), _table(),
+      _accepting(), _always_accepting(), _overflowed(false)
+{
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr bool Dfa<T, S, A, L>::add_bound(const T &bound) noexcept
+{
+    for (std::size_t i = 0; i < _n_classes; ++i)
+    {
+        if (_bounds[i] == bound)
+        {
+            return true;
+        }
+    }
+    if (_n_classes == A)
+    {
+        return false;
+    }
+    // Insertion keeps the bounds sorted
+    std::size_t i = _n_classes++;
+    for (; i > 0 && bound < _bounds[i - 1]; --i)
+    {
+        _bounds[i] = _bounds[i - 1];
+    }
+    _bounds[i] = bound;
+    return true;
+}
+
+// Branchless search of the last bound not greater than symbol
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr std::size_t Dfa<T, S, A, L>::search(const T &symbol) const noexcept
+{
+    std::size_t base = 0;
+    std::size_t count = _n_classes;
+    while (count > 1)
+    {
+        const std::size_t half = count / 2;
+        base = (symbol < _bounds[base + half]) ? base : base + half;
+        count -= half;
+    }
+    return base;
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr std::size_t Dfa<T, S, A, L>::classify(const T &symbol) const noexcept
+{
+    if constexpr (has_byte_map)
+    {
+        return _byte_classes[static_cast<unsigned char>(symbol)];
+    }
+    else
+    {
+        return search(symbol);
+    }
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+template <class Nfa>
+constexpr bool
+Dfa<T, S, A, L>::build(const Nfa &nfa, bool unanchored,
+                       std::array<std::size_t, S> *accepted) noexcept
+{
+    if constexpr (!std::integral<T>)
+    {
+        (void) nfa;
+        (void) unanchored;
+        (void) accepted;
+        return false;
+    }
+    else
+    {
+        _n_states = 0;
+        _n_classes = 0;
+        _overflowed = false;
+        if (!nfa._counters.empty())
+        {
+            return false;
+        }
+
+        // Every symbol and range of the NFA starts a class and ends one
+        bool fits = add_bound(std::numeric_limits<T>::lowest());
+        const auto add_range = [this, &fits](const T &lo, const T &hi)
+        {
+            fits = fits && add_bound(lo);
+            if (hi != std::numeric_limits<T>::max())
+            {
+                fits = fits && add_bound(static_cast<T>(hi + 1));
+            }
+        };
+        for (const auto &transition : nfa._transitions)
+        {
+            if (transition.epsilon)
+            {
+                continue;
+            }
+            if (transition.char_class == no_class)
+            {
+                add_range(transition.symbol, transition.symbol);
+                continue;
+            }
+            const auto &cls = nfa._classes[transition.char_class];
+            for (std::size_t r = 0; r < cls.size(); ++r)
+            {
+                add_range(cls[r].first, cls[r].second);
+            }
+        }
+        if (!fits)
+        {
+            _n_classes = 0;
+            return false;
+        }
+        if constexpr (has_byte_map)
+        {
+            for (std::size_t b = 0; b < 256; ++b)
+            {
+                _byte_classes[static_cast<unsigned char>(static_cast<T>(b))] =
+                    static_cast<std::uint8_t>(search(static_cast<T>(b)));
+            }
+        }
+
+        // Sets of NFA states are bitsets
+        constexpr std::size_t n_nfa = Nfa::max_states;
+        constexpr std::size_t words = (n_nfa + 63) / 64;
+        using set_type = std::array<std::uint64_t, words>;
+        const std::size_t n_transitions = nfa._transitions.size();
+
+        // Transitions grouped by source state
+        std::array<std::size_t, n_nfa + 1> begin = {};
+        std::array<std::size_t, Nfa::max_transitions> order = {};
+        for (const auto &transition : nfa._transitions)
+        {
+            ++begin[transition.from + 1];
+        }
+        for (std::size_t s = 0; s < n_nfa; ++s)
+        {
+            begin[s + 1] += begin[s];
+        }
+        std::array<std::size_t, n_nfa + 1> fill = begin;
+        for (std::size_t t = 0; t < n_transitions; ++t)
+        {
+            order[fill[nfa._transitions[t].from]++] = t;
+        }
+
+        // Epsilon closure of every state. The sets and the rows live on the
+        // heap, they outgrow the stack for the automata of large lexers
+        std::vector<set_type> closure(n_nfa);
+        for (std::size_t s = 0; s < nfa._states.size(); ++s)
+        {
+            closure[s][s / 64] |= std::uint64_t(1) << (s % 64);
+            ConstexprStack<std::size_t, n_nfa> work;
+            work.push(s);
+            while (!work.empty())
+            {
+                const std::size_t current = work.top();
+                work.pop();
+                for (std::size_t k = begin[current]; k < begin[current + 1];
+                     ++k)
+                {
+                    const auto &transition = nfa._transitions[order[k]];
+                    const std::uint64_t bit = std::uint64_t(1)
+                                              << (transition.to % 64);
+                    if (transition.epsilon
+                        && (closure[s][transition.to / 64] & bit) == 0)
+                    {
+                        closure[s][transition.to / 64] |= bit;
+                        work.push(transition.to);
+                    }
+                }
+            }
+        }
+        set_type final_states = {};
+        for (const auto &state : nfa._final_states)
+        {
+            final_states[state / 64] |= std::uint64_t(1) << (state % 64);
+        }
+
+        const auto intersects = [](const set_type &a, const set_type &b)
+        {
+            for (std::size_t w = 0; w < words; ++w)
+            {
+                if ((a[w] & b[w]) != 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+        // States reached from the set over the symbols of class c
+        const auto advance = [&](const set_type &from, std::size_t c)
+        {
+            set_type reached = {};
+            for (std::size_t s = 0; s < nfa._states.size(); ++s)
+            {
+                if ((from[s / 64] >> (s % 64) & 1) == 0)
+                {
+                    continue;
+                }
+                for (std::size_t k = begin[s]; k < begin[s + 1]; ++k)
+                {
+                    const auto &transition = nfa._transitions[order[k]];
+                    if (nfa.accepts(transition, _bounds[c]))
+                    {
+                        for (std::size_t w = 0; w < words; ++w)
+                        {
+                            reached[w] |= closure[transition.to][w];
+                        }
+                    }
+                }
+            }
+            return reached;
+        };
+
+        // Built whole, then handed to the table in its layout
+        std::vector<rows_type> table(1);
+        rows_type &rows = table.front();
+        std::vector<set_type> sets(S);
+        sets[1] = closure[nfa._initial_state];
+        // The states of an unanchored automaton are also split in groups by
+        // the position where their threads started, earliest first, a state
+        // belonging to the earliest thread that reaches it. Once a group
+        // accepts, the groups after it are dropped and no thread starts
+        std::vector<std::vector<set_type>> groups(unanchored ? S : 0);
+        std::vector<bool> found(unanchored ? S : 0);
+        if (unanchored)
+        {
+            groups[1] = {sets[1]};
+            found[1] = intersects(sets[1], final_states);
+        }
+        std::size_t n_states = 2;
+        for (std::size_t d = 1; d < n_states; ++d)
+        {
+            for (std::size_t w = 0; w < words; ++w)
+            {
+                _accepting[d] =
+                    _accepting[d] || (sets[d][w] & final_states[w]) != 0;
+            }
+            for (std::size_t k = 0; accepted != nullptr && _accepting[d]
+                                    && k < nfa._final_states.size();
+                 ++k)
+            {
+                const std::size_t state = nfa._final_states[k];
+                if ((sets[d][state / 64] >> (state % 64) & 1) != 0)
+                {
+                    (*accepted)[d] = k;
+                    break;
+                }
+            }
+            for (std::size_t c = 0; c < _n_classes; ++c)
+            {
+                set_type move = {};
+                std::vector<set_type> next;
+                bool next_found = false;
+                if (!unanchored)
+                {
+                    move = advance(sets[d], c);
+                }
+                else
+                {
+                    next_found = found[d];
+                    for (const set_type &group : groups[d])
+                    {
+                        next.push_back(advance(group, c));
+                    }
+                    if (!next_found)
+                    {
+                        next.push_back(sets[1]);
+                    }
+                    // Each state stays with the earliest group reaching it
+                    for (std::size_t g = 0; g < next.size(); ++g)
+                    {
+                        for (std::size_t w = 0; w < words; ++w)
+                        {
+                            next[g][w] &= ~move[w];
+                            move[w] |= next[g][w];
+                        }
+                        if (intersects(next[g], final_states))
+                        {
+                            next_found = true;
+                            next.resize(g + 1);
+                        }
+                    }
+                    std::erase(next, set_type{});
+                }
+                std::size_t target = 0;
+                while (target < n_states
+                       && (sets[target] != move
+                           || (unanchored && move != set_type{}
+                               && (groups[target] != next
+                                   || found[target] != next_found))))
+                {
+                    ++target;
+                }
+                if (target == n_states)
+                {
+                    if (n_states == S)
+                    {
+                        _n_classes = 0;
+                        return false;
+                    }
+                    sets[n_states] = move;
+                    if (unanchored)
+                    {
+                        groups[n_states] = std::move(next);
+                        found[n_states] = next_found;
+                    }
+                    ++n_states;
+                }
+                rows[d * _n_classes + c] = static_cast<state_type>(target);
+            }
+        }
+        _n_states = n_states;
+        prune(rows);
+        if (!_table.assign(rows, _n_states, _n_classes))
+        {
+            _n_states = 0;
+            _n_classes = 0;
+            _overflowed = true;
+            return false;
+        }
+        return true;
+    }
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr MemorySize Dfa<T, S, A, L>::memory_usage() const noexcept
+{
+    if (!valid())
+    {
+        return {0, sizeof(*this)};
+    }
+    MemorySize usage = _table.memory_usage(_n_states);
+    usage.used += sizeof(_n_states) + sizeof(_n_classes)
+                  + _n_classes * sizeof(T) + 2 * _n_states * sizeof(bool)
+                  + (has_byte_map ? sizeof(_byte_classes) : 0);
+    usage.reserved = sizeof(*this);
+    return usage;
+}
+
+// Transitions into states that cannot reach an accepting state are sent to
+// the dead state, and the states where every continuation is accepted are
+// marked, so that a run can stop as soon as its outcome is known
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr void Dfa<T, S, A, L>::prune(rows_type &rows) noexcept
+{
+    std::array<bool, S> live = _accepting;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (std::size_t d = 1; d < _n_states; ++d)
+        {
+            for (std::size_t c = 0; c < _n_classes && !live[d]; ++c)
+            {
+                if (live[rows[d * _n_classes + c]])
+                {
+                    live[d] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < _n_states * _n_classes; ++i)
+    {
+        if (!live[rows[i]])
+        {
+            rows[i] = dead_state;
+        }
+    }
+    mark_always_accepting(rows);
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr void
+Dfa<T, S, A, L>::mark_always_accepting(const rows_type &rows) noexcept
+{
+    _always_accepting = _accepting;
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (std::size_t d = 1; d < _n_states; ++d)
+        {
+            for (std::size_t c = 0; c < _n_classes && _always_accepting[d];
+                 ++c)
+            {
+                if (!_always_accepting[rows[d * _n_classes + c]])
+                {
+                    _always_accepting[d] = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+template <class It, class Sentinel>
+constexpr void Dfa<T, S, A, L>::profile(It first, Sentinel last,
+                                     profile_type &visits) const noexcept
+{
+    state_type state = initial();
+    ++visits[state];
+    for (; first != last && !dead(state); ++first)
+    {
+        state = next(state, static_cast<T>(*first));
+        ++visits[state];
+    }
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr void Dfa<T, S, A, L>::relayout(const profile_type &visits) noexcept
+{
+    if (_n_states <= 2)
+    {
+        return;
+    }
+    std::array<state_type, S> order = {};
+    for (std::size_t d = 0; d < _n_states; ++d)
+    {
+        order[d] = static_cast<state_type>(d);
+    }
+    std::sort(order.begin() + 2, order.begin() + _n_states,
+              [&visits](const state_type a, const state_type b)
+              {
+                  return visits[a] > visits[b]
+                         || (visits[a] == visits[b] && a < b);
+              });
+    std::array<state_type, S> renumbered = {};
+    for (std::size_t d = 0; d < _n_states; ++d)
+    {
+        renumbered[order[d]] = static_cast<state_type>(d);
+    }
+
+    // The rows and the new table live on the heap, as in build()
+    std::vector<rows_type> staging(1);
+    rows_type &rows = staging.front();
+    std::array<bool, S> accepting = {};
+    std::array<bool, S> always_accepting = {};
+    for (std::size_t d = 0; d < _n_states; ++d)
+    {
+        const std::size_t from = order[d];
+        for (std::size_t c = 0; c < _n_classes; ++c)
+        {
+            rows[d * _n_classes + c] = renumbered[_table.at(from, c)];
+        }
+        accepting[d] = _accepting[from];
+        always_accepting[d] = _always_accepting[from];
+    }
+    // A compressed table may not fit in the new order, the old one stays
+    std::vector<table_type> table(1);
+    if (!table.front().assign(rows, _n_states, _n_classes))
+    {
+        return;
+    }
+    _table = table.front();
+    _accepting = accepting;
+    _always_accepting = always_accepting;
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+bool Dfa<T, S, A, L>::save(std::ostream &os) const
+{
+    const auto write = [&os](const auto *data, std::size_t count)
+    {
+        os.write(reinterpret_cast<const char *>(data),
+                 static_cast<std::streamsize>(count * sizeof(*data)));
+    };
+    const std::array<std::uint64_t, 5> header = {
+        magic, sizeof(T), S, _n_states, _n_classes};
+    write(header.data(), header.size());
+    write(_bounds.data(), _n_classes);
+    write(_byte_classes.data(), _byte_classes.size());
+    // Rows are saved whole whatever the layout
+    for (std::size_t d = 0; d < _n_states; ++d)
+    {
+        std::array<state_type, A> row = {};
+        for (std::size_t c = 0; c < _n_classes; ++c)
+        {
+            row[c] = _table.at(d, c);
+        }
+        write(row.data(), _n_classes);
+    }
+    write(_accepting.data(), _n_states);
+    write(_always_accepting.data(), _n_states);
+    return static_cast<bool>(os);
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+bool Dfa<T, S, A, L>::load(std::istream &is)
+{
+    const auto read = [&is](auto *data, std::size_t count)
+    {
+        return static_cast<bool>(
+            is.read(reinterpret_cast<char *>(data),
+                    static_cast<std::streamsize>(count * sizeof(*data))));
+    };
+    std::array<std::uint64_t, 5> header = {};
+    if (!read(header.data(), header.size()) || header[0] != magic
+        || header[1] != sizeof(T) || header[2] != S || header[3] > S
+        || header[4] > A)
+    {
+        return false;
+    }
+    // The automaton and its rows live on the heap, as in build()
+    std::vector<Dfa> staging(1);
+    std::vector<rows_type> table(1);
+    Dfa &loaded = staging.front();
+    rows_type &rows = table.front();
+    loaded._n_states = static_cast<std::size_t>(header[3]);
+    loaded._n_classes = static_cast<std::size_t>(header[4]);
+    const std::size_t n_entries = loaded._n_states * loaded._n_classes;
+    if (!read(loaded._bounds.data(), loaded._n_classes)
+        || !read(loaded._byte_classes.data(), loaded._byte_classes.size())
+        || !read(rows.data(), n_entries)
+        || !read(loaded._accepting.data(), loaded._n_states)
+        || !read(loaded._always_accepting.data(), loaded._n_states))
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < n_entries; ++i)
+    {
+        if (rows[i] >= loaded._n_states)
+        {
+            return false;
+        }
+    }
+    // Classes start at the lowest symbol and their bounds increase, the
+    // byte map and the states accepting every input follow from the rest
+    for (std::size_t c = 0; c < loaded._n_classes; ++c)
+    {
+        if ((c == 0 && loaded._bounds[c] != std::numeric_limits<T>::lowest())
+            || (c != 0 && !(loaded._bounds[c - 1] < loaded._bounds[c])))
+        {
+            return false;
+        }
+    }
+    if constexpr (has_byte_map)
+    {
+        for (std::size_t b = 0; b < 256; ++b)
+        {
+            loaded._byte_classes[static_cast<unsigned char>(
+                static_cast<T>(b))] =
+                static_cast<std::uint8_t>(loaded.search(static_cast<T>(b)));
+        }
+    }
+    loaded.mark_always_accepting(rows);
+    if (!loaded._table.assign(rows, loaded._n_states, loaded._n_classes))
+    {
+        return false;
+    }
+    *this = loaded;
+    return true;
+}
+
+// Matches the states of both automata from their initial states, which
+// reach every state but the dead one
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+constexpr bool Dfa<T, S, A, L>::isomorphic(const Dfa &other) const noexcept
+{
+    if (_n_states != other._n_states || _n_classes != other._n_classes)
+    {
+        return false;
+    }
+    for (std::size_t c = 0; c < _n_classes; ++c)
+    {
+        if (_bounds[c] != other._bounds[c])
+        {
+            return false;
+        }
+    }
+    if (_n_states == 0)
+    {
+        return true;
+    }
+    // States not matched yet map to _n_states, which is no state
+    std::array<state_type, S> to_other = {};
+    std::array<state_type, S> to_this = {};
+    const auto unmatched = static_cast<state_type>(_n_states);
+    to_other.fill(unmatched);
+    to_this.fill(unmatched);
+    to_other[dead_state] = to_this[dead_state] = dead_state;
+    to_other[initial()] = to_this[initial()] = initial();
+    std::array<state_type, S> queue = {};
+    std::size_t n_queued = 0;
+    queue[n_queued++] = initial();
+    for (std::size_t q = 0; q < n_queued; ++q)
+    {
+        const state_type d = queue[q];
+        const state_type e = to_other[d];
+        if (_accepting[d] != other._accepting[e])
+        {
+            return false;
+        }
+        for (std::size_t c = 0; c < _n_classes; ++c)
+        {
+            const state_type to = _table.at(d, c);
+            const state_type other_to = other._table.at(e, c);
+            if (to_other[to] == unmatched && to_this[other_to] == unmatched)
+            {
+                to_other[to] = other_to;
+                to_this[other_to] = to;
+                queue[n_queued++] = to;
+            }
+            else if (to_other[to] != other_to || to_this[other_to] != to)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Mermaid flowchart of an automaton, its states colored by the number of
+// visits of a profile. Edges read like those of Transition: from --> |class|
+// to, one per run of classes leading to the same state
+template <class T, std::size_t S, std::size_t A, DfaLayout L> struct DfaHeatmap
+{
+    const Dfa<T, S, A, L> &dfa;
+    const typename Dfa<T, S, A, L>::profile_type &visits;
+};
+
+template <class T>
+void write_heatmap_symbol(std::ostream &os, const T &symbol)
+{
+    const bool alphanumeric = (symbol >= T('0') && symbol <= T('9'))
+                              || (symbol >= T('A') && symbol <= T('Z'))
+                              || (symbol >= T('a') && symbol <= T('z'));
+    if constexpr (sizeof(T) == 1)
+    {
+        if (alphanumeric)
+        {
+            os << static_cast<char>(symbol);
+            return;
+        }
+    }
+    os << +symbol;
+}
+
+template <class T, std::size_t S, std::size_t A, DfaLayout L>
+std::ostream &operator<<(std::ostream &os,
+                         const DfaHeatmap<T, S, A, L> &heatmap)
+{
+    const auto &dfa = heatmap.dfa;
+    std::size_t hottest = 1;
+    for (std::size_t d = 1; d < dfa._n_states; ++d)
+    {
+        hottest = std::max(hottest, heatmap.visits[d]);
+    }
+
+    os << "flowchart LR\n";
+    for (std::size_t d = 1; d < dfa._n_states; ++d)
+    {
+        os << "    " << d << (dfa._accepting[d] ? "((\"" : "(\"") << d << ": "
+           << heatmap.visits[d] << (dfa._accepting[d] ? "\"))" : "\")")
+           << "\n";
+    }
+    for (std::size_t d = 1; d < dfa._n_states; ++d)
+    {
+        for (std::size_t c = 0; c < dfa._n_classes;)
+        {
+            const auto to = dfa._table.at(d, c);
+            std::size_t end = c + 1;
+            while (end < dfa._n_classes
+                   && dfa._table.at(d, end) == to)
+            {
+                ++end;
+            }
+            if (to != dfa.dead_state)
+            {
+                os << "    " << d << " --> |";
+                write_heatmap_symbol(os, dfa._bounds[c]);
+                const T hi = (end < dfa._n_classes)
+                                 ? T(dfa._bounds[end] - 1)
+                                 : std::numeric_limits<T>::max();
+                if (hi != dfa._bounds[c])
+                {
+                    os << "-";
+                    write_heatmap_symbol(os, hi);
+                }
+                os << "| " << to << "\n";
+            }
+            c = end;
+        }
+    }
+
+    constexpr std::array<const char *, 5> fills = {
+        "#ffffff", "#ffe5cc", "#ffb366", "#ff8000", "#cc3300"};
+    for (std::size_t level = 0; level < fills.size(); ++level)
+    {
+        os << "    classDef heat" << level << " fill:" << fills[level] << "\n";
+    }
+    for (std::size_t d = 1; d < dfa._n_states; ++d)
+    {
+        const std::size_t visits = heatmap.visits[d];
+        const std::size_t level =
+            (visits == 0) ? 0 : 1 + (visits * (fills.size() - 2)) / hottest;
+        os << "    class " << d << " heat" << level << "\n";
+    }
+    return os;
+}
+
+} // namespace regez
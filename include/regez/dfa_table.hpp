@@ -0,0 +1,229 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <regez/memory_usage.hpp>
+
+namespace regez
+{
+
+// Storage of the transition table of a Dfa
+enum DfaLayout
+{
+    dfa_dense = 0,  // one entry per state and class
+    dfa_compressed, // rows stored as their differences with another row
+};
+
+// Defining REGEZ_COMPRESSED_DFA makes every automaton compressed
+#ifdef REGEZ_COMPRESSED_DFA
+constexpr DfaLayout default_dfa_layout = DfaLayout::dfa_compressed;
+#else
+constexpr DfaLayout default_dfa_layout = DfaLayout::dfa_dense;
+#endif
+
+// Every entry of the table, S rows of up to A classes
+template <std::size_t S, std::size_t A> class DenseTable
+{
+  public:
+    using state_type = std::uint32_t;
+    using rows_type = std::array<state_type, S * A>;
+
+    constexpr explicit DenseTable() noexcept : _n_classes(0), _rows()
+    {
+    }
+    // Takes the rows of n_states states, never fails
+    constexpr bool assign(const rows_type &rows,
+                          [[maybe_unused]] std::size_t n_states,
+                          std::size_t n_classes) noexcept
+    {
+        _rows = rows;
+        _n_classes = n_classes;
+        return true;
+    }
+    constexpr state_type at(const std::size_t state,
+                            const std::size_t cls) const noexcept
+    {
+        return _rows[state * _n_classes + cls];
+    }
+    constexpr MemorySize memory_usage(const std::size_t n_states) const
+        noexcept
+    {
+        return {sizeof(_n_classes)
+                    + n_states * _n_classes * sizeof(state_type),
+                sizeof(*this)};
+    }
+
+  private:
+    std::size_t _n_classes;
+    rows_type _rows;
+};
+
+// Comb-packed table with default rows. A state stores only the entries
+// that differ from the row of its default state, and reads the others from
+// it; a state without a default is dead on the classes it does not store.
+// The entries of all states share one array: those of a state start at its
+// base and are told apart by their check entry, which holds their state.
+//
+// Defaults are picked among the previous few states, and chains stay short
+// enough that a lookup reads at most max_depth + 1 rows. The packed entries
+// have room for a sixteenth of the entries of a dense table, an eighth of its
+// space with their check entries, and assign() fails when they do not fit.
+template <std::size_t S, std::size_t A> class CompressedTable
+{
+  public:
+    using state_type = std::uint32_t;
+    using rows_type = std::array<state_type, S * A>;
+
+    constexpr explicit CompressedTable() noexcept
+        : _base(), _default(), _next(), _check()
+    {
+    }
+    constexpr bool assign(const rows_type &rows, std::size_t n_states,
+                          std::size_t n_classes) noexcept;
+    constexpr state_type at(const std::size_t state,
+                            const std::size_t cls) const noexcept
+    {
+        for (auto s = static_cast<state_type>(state);;)
+        {
+            const std::size_t slot = _base[s] + cls;
+            if (_check[slot] == s)
+            {
+                return _next[slot];
+            }
+            s = _default[s];
+            if (s == no_state)
+            {
+                return 0;
+            }
+        }
+    }
+    // The packed entries count up to the last one in use
+    constexpr MemorySize memory_usage(const std::size_t n_states) const
+        noexcept
+    {
+        std::size_t slots = capacity;
+        while (slots > 0 && _check[slots - 1] == no_state)
+        {
+            --slots;
+        }
+        return {2 * (n_states + slots) * sizeof(state_type), sizeof(*this)};
+    }
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    constexpr static std::size_t max_base = S * A / 16;
+    constexpr static std::size_t capacity = max_base + A;
+    constexpr static std::size_t window = 16;
+    constexpr static std::size_t max_depth = 3;
+    constexpr static state_type no_state =
+        std::numeric_limits<state_type>::max();
+
+    std::array<state_type, S> _base;
+    std::array<state_type, S> _default;
+    std::array<state_type, capacity> _next;
+    std::array<state_type, capacity> _check;
+};
+
+template <std::size_t S, std::size_t A>
+constexpr bool CompressedTable<S, A>::assign(const rows_type &rows,
+                                             std::size_t n_states,
+                                             std::size_t n_classes) noexcept
+{
+    _next.fill(0);
+    _check.fill(no_state);
+    std::array<std::size_t, S> depth = {};
+    std::array<std::size_t, A> entries = {};
+    for (std::size_t s = 0; s < n_states; ++s)
+    {
+        const std::size_t row = s * n_classes;
+        // Without a default, the entries that are not dead are stored
+        std::size_t best = no_state;
+        std::size_t best_count = 0;
+        for (std::size_t c = 0; c < n_classes; ++c)
+        {
+            best_count += (rows[row + c] != 0);
+        }
+        for (std::size_t t = (s > window) ? s - window : 0; t < s; ++t)
+        {
+            if (depth[t] == max_depth)
+            {
+                continue;
+            }
+            std::size_t count = 0;
+            for (std::size_t c = 0; c < n_classes && count < best_count; ++c)
+            {
+                count += (rows[row + c] != rows[t * n_classes + c]);
+            }
+            if (count < best_count)
+            {
+                best = t;
+                best_count = count;
+            }
+        }
+
+        std::size_t n_entries = 0;
+        for (std::size_t c = 0; c < n_classes; ++c)
+        {
+            const state_type fallback =
+                (best == no_state) ? 0 : rows[best * n_classes + c];
+            if (rows[row + c] != fallback)
+            {
+                entries[n_entries++] = c;
+            }
+        }
+        // First base where the entries fall on free slots
+        std::size_t base = 0;
+        for (std::size_t i = 0; i < n_entries;)
+        {
+            if (_check[base + entries[i]] == no_state)
+            {
+                ++i;
+                continue;
+            }
+            if (++base > max_base)
+            {
+                return false;
+            }
+            i = 0;
+        }
+        for (std::size_t i = 0; i < n_entries; ++i)
+        {
+            _next[base + entries[i]] = rows[row + entries[i]];
+            _check[base + entries[i]] = static_cast<state_type>(s);
+        }
+        _base[s] = static_cast<state_type>(base);
+        _default[s] = static_cast<state_type>(best);
+        depth[s] = (best == no_state) ? 0 : depth[best] + 1;
+    }
+    return true;
+}
+
+} // namespace regez
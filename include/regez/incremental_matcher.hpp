@@ -0,0 +1,279 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <ranges>
+#include <regez/regez_constexpr.hpp>
+#include <vector>
+
+namespace regez
+{
+
+// Keeps whether an input matches a regex across appends and edits of the
+// input without reading it all again. The state of the DFA is saved at every
+// multiple of interval symbols: an update resumes from the last checkpoint before the
+// change, and stops once past it at a checkpoint whose state did not
+// change, since everything after it is then unchanged as well.
+//
+// Every update takes the whole input as it is after the change. Patterns
+// without a DFA are matched from the start at every update.
+template <class Regex> class IncrementalMatcher
+{
+  public:
+    using value_type = Regex::value_type;
+    constexpr explicit IncrementalMatcher(const Regex &regex,
+                                          std::size_t interval = 64) noexcept;
+
+    // Reads the whole input
+    template <symbol_range<value_type> R>
+        requires std::ranges::forward_range<R>
+    constexpr bool assign(R &&input) noexcept;
+    // The input grew at its end, only the new symbols are read
+    template <symbol_range<value_type> R>
+        requires std::ranges::forward_range<R>
+    constexpr bool append(R &&input) noexcept;
+    // The removed symbols of the previous input starting at position were
+    // replaced by the inserted ones
+    template <symbol_range<value_type> R>
+        requires std::ranges::forward_range<R>
+    constexpr bool edit(R &&input, std::size_t position, std::size_t removed,
+                        std::size_t inserted) noexcept;
+
+    // Whether the whole input matches
+    constexpr bool matched() const noexcept;
+    // Length of the input
+    constexpr std::size_t size() const noexcept;
+    // Symbols read by the last update
+    constexpr std::size_t scanned() const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    using state_type = Regex::dfa_type::state_type;
+    // State of the DFA after reading the first position symbols
+    struct Checkpoint
+    {
+        std::size_t position;
+        state_type state;
+    };
+
+    const Regex *_regex;
+    std::size_t _interval;
+    std::vector<Checkpoint> _checkpoints;
+    state_type _state;
+    std::size_t _size;
+    std::size_t _scanned;
+    bool _matched;
+
+    constexpr bool incremental() const noexcept;
+    template <class It, class Sentinel>
+    constexpr void scan(It first, Sentinel last, std::size_t position,
+                        state_type state,
+                        std::vector<Checkpoint> &&tail) noexcept;
+};
+
+template <class Regex>
+constexpr IncrementalMatcher<Regex>::IncrementalMatcher(
+    const Regex &regex, std::size_t interval) noexcept
+    : _regex(&regex), _interval(interval == 0 ? 1 : interval),
+      _checkpoints(), _state(), _size(0), _scanned(0), _matched(false)
+{
+}
+
+template <class Regex>
+constexpr bool IncrementalMatcher<Regex>::incremental() const noexcept
+{
+    return _regex->_anchored.valid();
+}
+
+template <class Regex>
+template <symbol_range<typename Regex::value_type> R>
+    requires std::ranges::forward_range<R>
+constexpr bool IncrementalMatcher<Regex>::assign(R &&input) noexcept
+{
+    if (!incremental())
+    {
+        _size = static_cast<std::size_t>(std::ranges::distance(input));
+        _scanned = _size;
+        _matched = _regex->match(input);
+        return _matched;
+    }
+    _checkpoints.clear();
+    _checkpoints.push_back({0, _regex->_anchored.initial()});
+    scan(std::ranges::begin(input), std::ranges::end(input), 0,
+         _regex->_anchored.initial(), {});
+    return _matched;
+}
+
+template <class Regex>
+template <symbol_range<typename Regex::value_type> R>
+    requires std::ranges::forward_range<R>
+constexpr bool IncrementalMatcher<Regex>::append(R &&input) noexcept
+{
+    return edit(std::forward<R>(input), _size, 0,
+                static_cast<std::size_t>(std::ranges::distance(input))
+                    - _size);
+}
+
+template <class Regex>
+template <symbol_range<typename Regex::value_type> R>
+    requires std::ranges::forward_range<R>
+constexpr bool IncrementalMatcher<Regex>::edit(R &&input,
+                                               std::size_t position,
+                                               std::size_t removed,
+                                               std::size_t inserted) noexcept
+{
+    if (!incremental() || _checkpoints.empty())
+    {
+        return assign(std::forward<R>(input));
+    }
+
+    // The checkpoints after the removed symbols move with the insertion,
+    // the ones in between are lost
+    std::size_t resume = 0;
+    while (resume + 1 < _checkpoints.size()
+           && _checkpoints[resume + 1].position <= position)
+    {
+        ++resume;
+    }
+    std::vector<Checkpoint> tail;
+    for (std::size_t c = resume + 1; c < _checkpoints.size(); ++c)
+    {
+        if (_checkpoints[c].position >= position + removed)
+        {
+            tail.push_back({_checkpoints[c].position - removed + inserted,
+                            _checkpoints[c].state});
+        }
+    }
+    // The end of the input stands for a checkpoint, appends resume from it
+    Checkpoint from = _checkpoints[resume];
+    if (position == _size)
+    {
+        from = {_size, _state};
+    }
+    else
+    {
+        tail.push_back({_size - removed + inserted, _state});
+    }
+    _checkpoints.resize(resume + 1);
+    auto first = std::ranges::next(
+        std::ranges::begin(input),
+        static_cast<std::ranges::range_difference_t<R>>(from.position));
+    scan(std::move(first), std::ranges::end(input), from.position, from.state,
+         std::move(tail));
+    return _matched;
+}
+
+// Runs the DFA from position, saving checkpoints, until the end of the input
+// or a checkpoint of the tail whose state is unchanged. The last checkpoint
+// of a tail is the end of the input
+template <class Regex>
+template <class It, class Sentinel>
+constexpr void IncrementalMatcher<Regex>::scan(
+    It first, Sentinel last, std::size_t position, state_type state,
+    std::vector<Checkpoint> &&tail) noexcept
+{
+    const auto &dfa = _regex->_anchored;
+    std::size_t next_tail = 0;
+    // Checkpoints sit at multiples of the interval wherever the scan
+    // resumes, so that appends shorter than the interval still add them
+    std::size_t next_checkpoint
+        = (position + _interval - 1) / _interval * _interval;
+    if (_checkpoints.back().position == next_checkpoint)
+    {
+        next_checkpoint += _interval;
+    }
+    bool converged = false;
+    _scanned = 0;
+    for (;; ++first, ++position, ++_scanned)
+    {
+        if (next_tail < tail.size() && tail[next_tail].position == position)
+        {
+            if (tail[next_tail].state == state)
+            {
+                converged = true;
+                break;
+            }
+            tail[next_tail++].state = state;
+        }
+        if (first == last)
+        {
+            break;
+        }
+        if (position == next_checkpoint)
+        {
+            // New checkpoints only where nothing is left of the old ones
+            if (next_tail == 0)
+            {
+                _checkpoints.push_back({position, state});
+            }
+            next_checkpoint += _interval;
+        }
+        state = dfa.next(state, static_cast<value_type>(*first));
+    }
+
+    if (converged)
+    {
+        _state = tail.back().state;
+        _size = tail.back().position;
+        next_tail = tail.size();
+    }
+    else
+    {
+        _state = state;
+        _size = position;
+    }
+    if (!tail.empty())
+    {
+        next_tail = std::min(next_tail, tail.size() - 1);
+    }
+    _checkpoints.insert(_checkpoints.end(), tail.begin(),
+                        tail.begin() + static_cast<std::ptrdiff_t>(next_tail));
+    _matched = dfa.accepting(_state);
+}
+
+template <class Regex>
+constexpr bool IncrementalMatcher<Regex>::matched() const noexcept
+{
+    return _matched;
+}
+
+template <class Regex>
+constexpr std::size_t IncrementalMatcher<Regex>::size() const noexcept
+{
+    return _size;
+}
+
+template <class Regex>
+constexpr std::size_t IncrementalMatcher<Regex>::scanned() const noexcept
+{
+    return _scanned;
+}
+
+} // namespace regez
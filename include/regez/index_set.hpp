@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace regez
+{
+
+// Set of indices below a bound known at run time, in the order they were
+// added. A bitmap answers membership in constant time, and clearing only
+// touches the indices that are present. Memory grows with the bound and the
+// number of indices added, not with a worst case fixed in advance
+class IndexSet
+{
+  public:
+    constexpr explicit IndexSet() noexcept = default;
+    // Empties the set and makes room for the indices below bound
+    constexpr void reset(std::size_t bound) noexcept;
+    // False when the index was already present
+    constexpr bool insert(std::size_t index) noexcept;
+    constexpr bool contains(std::size_t index) const noexcept;
+    constexpr void clear() noexcept;
+    // Keeps the first count indices added
+    constexpr void truncate(std::size_t count) noexcept;
+    constexpr std::size_t size() const noexcept
+    {
+        return m_indices.size();
+    }
+    constexpr bool empty() const noexcept
+    {
+        return m_indices.empty();
+    }
+    constexpr std::size_t operator[](std::size_t i) const noexcept
+    {
+        return m_indices[i];
+    }
+    constexpr std::vector<std::size_t>::const_iterator begin() const noexcept
+    {
+        return m_indices.begin();
+    }
+    constexpr std::vector<std::size_t>::const_iterator end() const noexcept
+    {
+        return m_indices.end();
+    }
+    // Bytes a set of indices below bound takes at most
+    constexpr static std::size_t bytes(std::size_t bound) noexcept
+    {
+        return bound * sizeof(std::size_t)
+               + (bound + 63) / 64 * sizeof(std::uint64_t);
+    }
+
+  private:
+    std::vector<std::size_t> m_indices;
+    std::vector<std::uint64_t> m_bitmap;
+};
+
+constexpr void IndexSet::reset(std::size_t bound) noexcept
+{
+    clear();
+    const std::size_t words = (bound + 63) / 64;
+    if (m_bitmap.size() < words)
+    {
+        m_bitmap.resize(words, 0);
+    }
+}
+
+constexpr bool IndexSet::insert(std::size_t index) noexcept
+{
+    std::uint64_t &word = m_bitmap[index / 64];
+    const std::uint64_t bit = std::uint64_t(1) << (index % 64);
+    if ((word & bit) != 0)
+    {
+        return false;
+    }
+    word |= bit;
+    m_indices.push_back(index);
+    return true;
+}
+
+constexpr bool IndexSet::contains(std::size_t index) const noexcept
+{
+    return (m_bitmap[index / 64] >> (index % 64) & 1) != 0;
+}
+
+constexpr void IndexSet::clear() noexcept
+{
+    for (const std::size_t index : m_indices)
+    {
+        m_bitmap[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+    }
+    m_indices.clear();
+}
+
+constexpr void IndexSet::truncate(std::size_t count) noexcept
+{
+    for (std::size_t i = count; i < m_indices.size(); ++i)
+    {
+        m_bitmap[m_indices[i] / 64] &=
+            ~(std::uint64_t(1) << (m_indices[i] % 64));
+    }
+    if (count < m_indices.size())
+    {
+        m_indices.resize(count);
+    }
+}
+
+} // namespace regez
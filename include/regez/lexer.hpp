@@ -0,0 +1,300 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <regez/dfa.hpp>
+#include <regez/regez_constexpr.hpp>
+#include <utility>
+
+namespace regez
+{
+
+// Token read by a Lexer: the id of its rule and where it is in the input
+struct Token
+{
+    std::size_t id;
+    std::size_t begin;
+    std::size_t end;
+
+    constexpr bool operator==(const Token &) const noexcept = default;
+};
+
+// Pattern of a Lexer and the id of the tokens it reads
+template <class Container> struct LexerRule
+{
+    Container pattern;
+    std::size_t id;
+};
+
+// Splits an input into the tokens of K rules of at most N symbols each, in a
+// single pass: at every position the longest token of any rule is read, and
+// among rules reading the same length the earliest one wins.
+//
+// The rules share one NFA, Thompson's construction of every rule reached by
+// an epsilon transition from a common initial state, and one DFA built from
+// it. Every accepting state of the DFA keeps the first rule whose final
+// state it contains. S and A bound the states and classes of the DFA as in
+// Dfa; rules with counted repetitions or automata larger than that make the
+// lexer invalid.
+template <class Container, std::size_t N, std::size_t K,
+          std::size_t S = K * (2 * N + 2) + 1,
+          std::size_t A =
+              sizeof(typename Container::value_type) == 1
+                  ? std::min<std::size_t>(K * (2 * N + 2), 256)
+                  : K * (2 * N + 2)>
+class Lexer
+{
+  public:
+    using value_type = Container::value_type;
+    using rule_type = LexerRule<Container>;
+    constexpr explicit Lexer(
+        const std::array<rule_type, K> &rules,
+        const VocabularyConstexpr<value_type> &vocab,
+        const Encoding encoding = Encoding::encoding_symbols) noexcept;
+    constexpr bool valid() const noexcept
+    {
+        return _dfa.valid();
+    }
+    // Longest token at the start of the input
+    template <symbol_range<value_type> R>
+        requires std::ranges::forward_range<R>
+    constexpr std::optional<Token> next(R &&input) const noexcept;
+    // Writes the tokens of the input to out, one after the other, and
+    // returns the length read: the whole input, or up to the first position
+    // where no rule reads a token. Rules never read an empty token
+    template <symbol_range<value_type> R, std::output_iterator<Token> Out>
+        requires std::ranges::forward_range<R>
+    constexpr std::size_t tokenize(R &&input, Out out) const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    using regex_type = RegexConstexpr<Container, N>;
+    using rule_machine_type = regex_type::state_machine_type;
+    constexpr static std::size_t max_states =
+        K * rule_machine_type::max_states + 1;
+    // Four transitions per token of a rule, and one to enter it
+    constexpr static std::size_t max_transitions = K * (4 * N + 1);
+    using state_machine_type =
+        StateMachine<value_type, max_states, max_transitions,
+                     Ast<value_type, N>::max_class_ranges>;
+    constexpr static std::size_t max_classes = max_states / 4 + 1;
+    using dfa_type = Dfa<value_type, S, A>;
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    dfa_type _dfa;
+    // Rule of every accepting state of the DFA
+    std::array<std::size_t, S> _rule;
+    std::array<std::size_t, K> _ids;
+
+    constexpr static bool merge(state_machine_type &sm,
+                                const rule_machine_type &rule) noexcept;
+    template <class It, class Sentinel>
+    constexpr std::pair<std::size_t, std::size_t>
+    longest(It &first, Sentinel last) const noexcept;
+};
+
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+constexpr Lexer<Container, N, K, S, A>::Lexer(
+    const std::array<rule_type, K> &rules,
+    const VocabularyConstexpr<value_type> &vocab,
+    const Encoding encoding) noexcept
+    : _dfa(), _rule(), _ids()
+{
+    const TokenClassifier<value_type> classifier(vocab);
+    state_machine_type sm;
+    sm._initial_state = sm.add_state();
+    // Rule of every final state of the NFA, in their order
+    std::array<std::size_t, max_states> final_rule = {};
+    bool fits = true;
+    for (std::size_t r = 0; r < K && fits; ++r)
+    {
+        _ids[r] = rules[r].id;
+        if (rules[r].pattern.size() > N)
+        {
+            fits = false;
+            continue;
+        }
+        auto ast = regex_type::ast_type::from_infix(rules[r].pattern,
+                                                    classifier, encoding);
+        ast.simplify();
+        const std::size_t first_final = sm._final_states.size();
+        fits = merge(sm, regex_type::thompson_construction(ast));
+        for (std::size_t f = first_final; f < sm._final_states.size(); ++f)
+        {
+            final_rule[f] = r;
+        }
+    }
+    if (!fits || !_dfa.build(sm, false, &_rule))
+    {
+        return;
+    }
+    for (std::size_t d = 0; d < _dfa.size(); ++d)
+    {
+        _rule[d] = _dfa.accepting(static_cast<dfa_type::state_type>(d))
+                       ? final_rule[_rule[d]]
+                       : npos;
+    }
+}
+
+// Copies the machine of a rule into the one of the lexer, entered from its
+// initial state
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+constexpr bool
+Lexer<Container, N, K, S, A>::merge(state_machine_type &sm,
+                                    const rule_machine_type &rule) noexcept
+{
+    if (!rule._counters.empty()
+        || sm._states.size() + rule._states.size() > max_states
+        || sm._transitions.size() + rule._transitions.size()
+               >= max_transitions
+        || sm._classes.size() + rule._classes.size() > max_classes)
+    {
+        return false;
+    }
+    const StateID offset = sm._states.size();
+    const std::size_t class_offset = sm._classes.size();
+    for (std::size_t s = 0; s < rule._states.size(); ++s)
+    {
+        sm.add_state();
+    }
+    for (const auto &cls : rule._classes)
+    {
+        sm.add_class(cls);
+    }
+    for (Transition<value_type> transition : rule._transitions)
+    {
+        transition.from += offset;
+        transition.to += offset;
+        if (transition.char_class != no_class)
+        {
+            transition.char_class += class_offset;
+        }
+        sm._transitions.push_back(transition);
+    }
+    sm.add_epsilon_transition(sm._initial_state,
+                              rule._initial_state + offset);
+    for (const StateID state : rule._final_states)
+    {
+        sm._final_states.push_back(state + offset);
+    }
+    return true;
+}
+
+// Moves first to the end of the longest token starting there, and returns
+// its rule and length. The rule is npos when no token starts there
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+template <class It, class Sentinel>
+constexpr std::pair<std::size_t, std::size_t>
+Lexer<Container, N, K, S, A>::longest(It &first, Sentinel last) const
+    noexcept
+{
+    std::size_t rule = npos;
+    std::size_t length = 0;
+    It end = first;
+    auto state = _dfa.initial();
+    std::size_t read = 0;
+    for (It it = first; it != last;)
+    {
+        state = _dfa.next(state, *it);
+        ++it;
+        ++read;
+        if (_dfa.dead(state))
+        {
+            break;
+        }
+        if (_dfa.accepting(state))
+        {
+            rule = _rule[state];
+            length = read;
+            end = it;
+        }
+    }
+    first = end;
+    return {rule, length};
+}
+
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::forward_range<R>
+constexpr std::optional<Token>
+Lexer<Container, N, K, S, A>::next(R &&input) const noexcept
+{
+    if (!valid())
+    {
+        return std::nullopt;
+    }
+    auto first = std::ranges::begin(input);
+    const auto [rule, length] = longest(first, std::ranges::end(input));
+    if (rule == npos)
+    {
+        return std::nullopt;
+    }
+    return Token{_ids[rule], 0, length};
+}
+
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+template <symbol_range<typename Container::value_type> R,
+          std::output_iterator<Token> Out>
+    requires std::ranges::forward_range<R>
+constexpr std::size_t Lexer<Container, N, K, S, A>::tokenize(R &&input,
+                                                              Out out) const
+    noexcept
+{
+    if (!valid())
+    {
+        return 0;
+    }
+    auto first = std::ranges::begin(input);
+    const auto last = std::ranges::end(input);
+    std::size_t position = 0;
+    while (first != last)
+    {
+        const auto [rule, length] = longest(first, last);
+        if (rule == npos)
+        {
+            break;
+        }
+        *out++ = Token{_ids[rule], position, position + length};
+        position += length;
+    }
+    return position;
+}
+
+} // namespace regez
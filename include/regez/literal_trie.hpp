@@ -0,0 +1,489 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <regez/ast.hpp>
+#include <regez/constexpr_vector.hpp>
+#include <regez/memory_usage.hpp>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace regez
+{
+
+// Aho-Corasick automaton for patterns that are an alternation of literals,
+// eg. GET|POST|PUT. The trie is stored in breadth first order with the
+// children of each node kept contiguous and sorted (CSR layout), so a step
+// reads one short run of labels instead of following an epsilon fan-out.
+// Lookups compare 16 labels at a time with SSE2 for single byte symbols.
+template <class T, std::size_t N> class LiteralTrie
+{
+  public:
+    using value_type = T;
+    constexpr static std::size_t max_nodes = N + 1;
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    constexpr explicit LiteralTrie() noexcept;
+    // Returns false, leaving the trie empty, if the tree is not an
+    // alternation of non empty literals
+    constexpr bool build(const Ast<T, N> &ast) noexcept;
+    // Whether the whole input is one of the literals
+    template <class It, class Sentinel>
+    constexpr bool match(It first, Sentinel last) const noexcept;
+    // Offset one past the end of the first occurrence of any literal to end
+    // in the input, or npos
+    template <class It, class Sentinel>
+    constexpr std::size_t find_end(It first, Sentinel last) const noexcept;
+    // Length of the longest literal the input starts with, or npos
+    template <class It, class Sentinel>
+    constexpr std::size_t prefix_end(It first, Sentinel last) const noexcept;
+    // Length of the longest literal
+    constexpr std::size_t longest() const noexcept
+    {
+        return _longest;
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return _n_nodes;
+    }
+    constexpr MemorySize memory_usage() const noexcept;
+
+    // Stepwise interface shared with the DFA, npos is the dead node
+    constexpr std::size_t initial() const noexcept
+    {
+        return _n_nodes == 0 ? npos : 0;
+    }
+    constexpr std::size_t next(const std::size_t node,
+                               const T &symbol) const noexcept
+    {
+        return child(node, symbol);
+    }
+    constexpr bool dead(const std::size_t node) const noexcept
+    {
+        return node == npos;
+    }
+    constexpr bool accepting(const std::size_t node) const noexcept
+    {
+        return _terminal[node];
+    }
+    constexpr bool always_accepting(const std::size_t) const noexcept
+    {
+        return false;
+    }
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    constexpr static std::size_t lanes = 16;
+    constexpr static std::size_t max_needles = 4;
+    constexpr static bool has_simd = sizeof(T) == 1 && std::is_integral_v<T>;
+
+    std::size_t _n_nodes;
+    std::size_t _longest;
+    // Children of node i are the edges in [_child_begin[i], _child_begin[i+1])
+    std::array<std::size_t, max_nodes + 1> _child_begin;
+    // Padded so that a vector load never reads past the end
+    std::array<T, N + lanes> _labels;
+    std::array<std::size_t, N> _targets;
+    std::array<std::size_t, max_nodes> _fail;
+    // A literal ends at this node
+    std::array<bool, max_nodes> _terminal;
+    // A literal ends at this node or at one of its suffixes
+    std::array<bool, max_nodes> _output;
+
+    constexpr static bool collect(const Ast<T, N> &ast, std::size_t id,
+                                  ConstexprVector<T, N> &symbols,
+                                  ConstexprVector<std::size_t, N> &ends,
+                                  bool alternation) noexcept;
+    constexpr std::size_t child(std::size_t node, const T &symbol) const
+        noexcept;
+    template <class It, class Sentinel>
+    constexpr It skip(It first, Sentinel last) const noexcept;
+};
+
+template <class T, std::size_t N>
+constexpr LiteralTrie<T, N>::LiteralTrie() noexcept
+    : _n_nodes(0), _longest(0), _child_begin(), _labels(), _targets(),
+      _fail(), _terminal(), _output()
+{
+}
+
+// Every node but the root is the target of one edge
+template <class T, std::size_t N>
+constexpr MemorySize LiteralTrie<T, N>::memory_usage() const noexcept
+{
+    const std::size_t edges = _n_nodes == 0 ? 0 : _n_nodes - 1;
+    return {sizeof(_n_nodes) + sizeof(_longest)
+                + (_n_nodes + 1) * sizeof(std::size_t)
+                + edges * (sizeof(T) + sizeof(std::size_t))
+                + _n_nodes * (sizeof(std::size_t) + 2 * sizeof(bool)),
+            sizeof(*this)};
+}
+
+// Appends the literals of the subtree to symbols. Below an alternation every
+// operand is a literal terminated by an entry in ends
+template <class T, std::size_t N>
+constexpr bool LiteralTrie<T, N>::collect(const Ast<T, N> &ast,
+                                          std::size_t id,
+                                          ConstexprVector<T, N> &symbols,
+                                          ConstexprVector<std::size_t, N> &ends,
+                                          bool alternation) noexcept
+{
+    const AstNode<T> &node = ast.node(id);
+    if (alternation)
+    {
+        if (node.kind != NodeKind::node_or)
+        {
+            if (!collect(ast, id, symbols, ends, false))
+            {
+                return false;
+            }
+            ends.push_back(symbols.size());
+            return true;
+        }
+    }
+    else if (node.kind == NodeKind::node_symbol)
+    {
+        symbols.push_back(node.symbol);
+        return true;
+    }
+    else if (node.kind != NodeKind::node_concat)
+    {
+        return false;
+    }
+    for (std::size_t c = node.first_child; c != no_node;
+         c = ast.node(c).next_sibling)
+    {
+        if (!collect(ast, c, symbols, ends, alternation))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class T, std::size_t N>
+constexpr bool LiteralTrie<T, N>::build(const Ast<T, N> &ast) noexcept
+{
+    *this = LiteralTrie();
+    ConstexprVector<T, N> symbols;
+    ConstexprVector<std::size_t, N> ends;
+    if (!ast.valid() || !collect(ast, ast.root(), symbols, ends, true))
+    {
+        return false;
+    }
+
+    // Insert the literals in a linked trie, siblings kept sorted
+    std::array<std::size_t, max_nodes> first_child;
+    std::array<std::size_t, max_nodes> next_sibling;
+    std::array<T, max_nodes> label = {};
+    std::array<bool, max_nodes> terminal = {};
+    first_child.fill(npos);
+    next_sibling.fill(npos);
+    std::size_t nodes = 1;
+    std::size_t begin = 0;
+    for (const auto &end : ends)
+    {
+        if (end == begin) // Empty literal
+        {
+            return false;
+        }
+        std::size_t node = 0;
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            std::size_t *link = &first_child[node];
+            while (*link != npos && !(label[*link] == symbols[i]))
+            {
+                if constexpr (std::totally_ordered<T>)
+                {
+                    if (symbols[i] < label[*link])
+                    {
+                        break;
+                    }
+                }
+                link = &next_sibling[*link];
+            }
+            if (*link == npos || !(label[*link] == symbols[i]))
+            {
+                label[nodes] = symbols[i];
+                next_sibling[nodes] = *link;
+                *link = nodes++;
+            }
+            node = *link;
+        }
+        terminal[node] = true;
+        _longest = std::max(_longest, end - begin);
+        begin = end;
+    }
+
+    // Renumber breadth first, the queue position is the new id
+    std::array<std::size_t, max_nodes> queue = {};
+    std::size_t tail = 1;
+    std::size_t edges = 0;
+    for (std::size_t head = 0; head < tail; ++head)
+    {
+        _child_begin[head] = edges;
+        _terminal[head] = terminal[queue[head]];
+        for (std::size_t c = first_child[queue[head]]; c != npos;
+             c = next_sibling[c])
+        {
+            _labels[edges] = label[c];
+            _targets[edges++] = tail;
+            queue[tail++] = c;
+        }
+    }
+    _child_begin[tail] = edges;
+    _n_nodes = tail;
+
+    // Failure links, a parent always precedes its children
+    _output[0] = _terminal[0];
+    for (std::size_t node = 0; node < _n_nodes; ++node)
+    {
+        for (std::size_t e = _child_begin[node]; e < _child_begin[node + 1];
+             ++e)
+        {
+            const std::size_t target = _targets[e];
+            std::size_t fail = 0;
+            if (node != 0)
+            {
+                fail = _fail[node];
+                while (fail != 0 && child(fail, _labels[e]) == npos)
+                {
+                    fail = _fail[fail];
+                }
+                fail = child(fail, _labels[e]);
+                if (fail == npos)
+                {
+                    fail = 0;
+                }
+            }
+            _fail[target] = fail;
+            _output[target] = _terminal[target] || _output[fail];
+        }
+    }
+    return true;
+}
+
+template <class T, std::size_t N>
+constexpr std::size_t LiteralTrie<T, N>::child(std::size_t node,
+                                               const T &symbol) const noexcept
+{
+    std::size_t begin = _child_begin[node];
+    const std::size_t end = _child_begin[node + 1];
+#if defined(__SSE2__)
+    if constexpr (has_simd)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            const __m128i needle = _mm_set1_epi8(static_cast<char>(symbol));
+            for (; begin < end; begin += lanes)
+            {
+                const __m128i labels = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(&_labels[begin]));
+                unsigned mask = static_cast<unsigned>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(labels, needle)));
+                if (end - begin < lanes)
+                {
+                    mask &= (1u << (end - begin)) - 1;
+                }
+                if (mask != 0)
+                {
+                    return _targets[begin
+                                    + static_cast<std::size_t>(
+                                        std::countr_zero(mask))];
+                }
+            }
+            return npos;
+        }
+    }
+#endif
+    if constexpr (std::totally_ordered<T>)
+    {
+        // Branchless binary search over the sorted labels
+        if (begin == end)
+        {
+            return npos;
+        }
+        std::size_t count = end - begin;
+        while (count > 1)
+        {
+            const std::size_t half = count / 2;
+            begin = (symbol < _labels[begin + half]) ? begin : begin + half;
+            count -= half;
+        }
+        return (_labels[begin] == symbol) ? _targets[begin] : npos;
+    }
+    else
+    {
+        for (; begin < end; ++begin)
+        {
+            if (_labels[begin] == symbol)
+            {
+                return _targets[begin];
+            }
+        }
+        return npos;
+    }
+}
+
+// Advances to the next symbol that starts a literal
+template <class T, std::size_t N>
+template <class It, class Sentinel>
+constexpr It LiteralTrie<T, N>::skip(It first, Sentinel last) const noexcept
+{
+    const std::size_t needles = _child_begin[1] - _child_begin[0];
+#if defined(__SSE2__)
+    if constexpr (has_simd && std::contiguous_iterator<It>
+                  && std::sized_sentinel_for<Sentinel, It>)
+    {
+        if (!std::is_constant_evaluated() && needles <= max_needles)
+        {
+            __m128i masks[max_needles];
+            for (std::size_t i = 0; i < needles; ++i)
+            {
+                masks[i] = _mm_set1_epi8(static_cast<char>(_labels[i]));
+            }
+            while (last - first >= static_cast<std::ptrdiff_t>(lanes))
+            {
+                const __m128i block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(std::to_address(first)));
+                __m128i hits = _mm_setzero_si128();
+                for (std::size_t i = 0; i < needles; ++i)
+                {
+                    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, masks[i]));
+                }
+                const unsigned mask =
+                    static_cast<unsigned>(_mm_movemask_epi8(hits));
+                if (mask != 0)
+                {
+                    return first + std::countr_zero(mask);
+                }
+                first += static_cast<std::ptrdiff_t>(lanes);
+            }
+        }
+    }
+#endif
+    (void) needles;
+    while (first != last && child(0, static_cast<T>(*first)) == npos)
+    {
+        ++first;
+    }
+    return first;
+}
+
+template <class T, std::size_t N>
+template <class It, class Sentinel>
+constexpr bool LiteralTrie<T, N>::match(It first, Sentinel last) const
+    noexcept
+{
+    if (_n_nodes == 0)
+    {
+        return false;
+    }
+    std::size_t node = 0;
+    for (; first != last; ++first)
+    {
+        node = child(node, static_cast<T>(*first));
+        if (node == npos)
+        {
+            return false;
+        }
+    }
+    return _terminal[node];
+}
+
+template <class T, std::size_t N>
+template <class It, class Sentinel>
+constexpr std::size_t LiteralTrie<T, N>::find_end(It first,
+                                                  Sentinel last) const noexcept
+{
+    if (_n_nodes == 0)
+    {
+        return npos;
+    }
+    std::size_t offset = 0;
+    std::size_t node = 0;
+    while (first != last)
+    {
+        if (node == 0)
+        {
+            It next = skip(first, last);
+            offset += static_cast<std::size_t>(std::distance(first, next));
+            first = next;
+            if (first == last)
+            {
+                break;
+            }
+        }
+        const T symbol = static_cast<T>(*first);
+        std::size_t next = child(node, symbol);
+        while (next == npos && node != 0)
+        {
+            node = _fail[node];
+            next = child(node, symbol);
+        }
+        node = (next == npos) ? 0 : next;
+        ++first;
+        ++offset;
+        if (_output[node])
+        {
+            return offset;
+        }
+    }
+    return npos;
+}
+
+template <class T, std::size_t N>
+template <class It, class Sentinel>
+constexpr std::size_t LiteralTrie<T, N>::prefix_end(It first,
+                                                    Sentinel last) const
+    noexcept
+{
+    std::size_t end = npos;
+    std::size_t node = initial();
+    for (std::size_t i = 1; node != npos && first != last; ++i, ++first)
+    {
+        node = child(node, static_cast<T>(*first));
+        if (node != npos && _terminal[node])
+        {
+            end = i;
+        }
+    }
+    return end;
+}
+
+} // namespace regez
@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Giovanni Santini
+
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+#pragma once
+
+#include <cstddef>
+
+namespace regez
+{
+
+// Bytes taken by a part of a compiled pattern: used by its content, and
+// reserved by the fixed capacities that hold it
+struct MemorySize
+{
+    std::size_t used;
+    std::size_t reserved;
+
+    constexpr MemorySize &operator+=(const MemorySize &other) noexcept
+    {
+        used += other.used;
+        reserved += other.reserved;
+        return *this;
+    }
+    constexpr bool operator==(const MemorySize &) const noexcept = default;
+};
+
+// Where the memory of a compiled pattern goes. The reserved sizes of the
+// parts of a regex add up to its size, the scratch excepted, which is held
+// by the caller. Automata whose compressed table did not fit are counted
+// apart: their matches run on the NFA, which needs the scratch
+struct MemoryUsage
+{
+    MemorySize nfa_states; // states, final states and transition index
+    MemorySize nfa_transitions;
+    MemorySize nfa_classes; // character classes and counters
+    MemorySize dfa_tables;  // tables, class maps and accepting flags
+    MemorySize literals;    // the trie of an alternation of literals
+    MemorySize scratch;     // working sets of the NFA, with their heap
+    MemorySize other;       // everything else, padding included
+    std::size_t dfa_overflows;
+
+    constexpr MemorySize total() const noexcept
+    {
+        MemorySize sum = nfa_states;
+        sum += nfa_transitions;
+        sum += nfa_classes;
+        sum += dfa_tables;
+        sum += literals;
+        sum += scratch;
+        sum += other;
+        return sum;
+    }
+};
+
+} // namespace regez
@@ -35,11 +35,16 @@ enum Operators
     op_concat,
     op_any,         // *
     op_one_or_more, // +
-    op_open_group,  // (
-    op_close_group, // )
-    // op_open_match,  // [
-    // op_close_match, // ]
-    op_escape, // "\"
+    op_open_group,   // (
+    op_close_group,  // )
+    op_escape,       // "\"
+    op_open_repeat,  // {
+    op_close_repeat, // }
+    op_repeat_sep,   // ,
+    op_open_match,   // [
+    op_close_match,  // ]
+    op_range,        // -
+    op_negate,       // ^
     _op_max
 };
 
@@ -28,12 +28,14 @@
 
 #include <array>
 #include <memory>
-#include <stack>
+#include <optional>
+#include <vector>
 #if __cplusplus > 201703L // C++ 17
 #include <concepts>
 #endif
 
 #include <regez/operators.hpp>
+#include <regez/regez_constexpr.hpp>
 
 namespace regez
 {
@@ -44,13 +46,18 @@ template <class Type> class Vocabulary
     using value_type = Type;
     explicit Vocabulary() noexcept;
     value_type get(const Operators op) const noexcept;
+    // Whether set() gave a token to the operator, the tokens of the others
+    // are plain symbols
+    bool has(const Operators op) const noexcept;
     Vocabulary &&set(Operators op, value_type value) noexcept;
 
   private:
     std::array<value_type, Operators::_op_max> _vocab;
+    std::array<bool, Operators::_op_max> _defined;
 };
 
-template <class Type> Vocabulary<Type>::Vocabulary() noexcept
+template <class Type>
+Vocabulary<Type>::Vocabulary() noexcept : _vocab(), _defined()
 {
 }
 
@@ -61,16 +68,69 @@ Vocabulary<Type>::get(const Operators op) const noexcept
     return _vocab[op];
 }
 
+template <class Type>
+bool Vocabulary<Type>::has(const Operators op) const noexcept
+{
+    return _defined[op];
+}
+
 template <class Type>
 Vocabulary<Type> &&Vocabulary<Type>::set(Operators op,
                                          value_type value) noexcept
 {
     _vocab[op] = value;
+    _defined[op] = true;
     return std::move(*this);
 }
 
+// Working memory of a match. A context serves one thread at a time and can
+// be reused for any number of matches, which then allocate nothing
+template <class Container,
+          class Alloc = std::allocator<typename Container::value_type>,
+          std::size_t N = 64>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+class MatchContext
+{
+  public:
+    using scratch_type = RegexConstexpr<Container, N>::Scratch;
+    explicit MatchContext(const Alloc &alloc = Alloc()) noexcept;
+    scratch_type &scratch() noexcept;
+
+  private:
+    using allocator_type =
+        std::allocator_traits<Alloc>::template rebind_alloc<scratch_type>;
+    // Allocated once with the context, its sets keep the room they grew to
+    std::vector<scratch_type, allocator_type> _scratch;
+};
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+MatchContext<Container, Alloc, N>::MatchContext(const Alloc &alloc) noexcept
+    : _scratch(1, allocator_type(alloc))
+{
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+MatchContext<Container, Alloc, N>::scratch_type &
+MatchContext<Container, Alloc, N>::scratch() noexcept
+{
+    return _scratch.front();
+}
+
+// A handle to an immutable compiled program: copies share the program, and
+// any number of threads may match with it at once, each with its own context.
+// Patterns are limited to N symbols, 64 by default. A longer one is not
+// compiled and leaves the regex invalid, a larger N makes room for it
 template <class Container,
-          class Alloc = std::allocator<typename Container::value_type>>
+          class Alloc = std::allocator<typename Container::value_type>,
+          std::size_t N = 64>
 #if __cplusplus > 201703L // C++ 20
     requires std::default_initializable<Container>
 #endif
@@ -78,62 +138,259 @@ class Regex
 {
   public:
     using value_type = Container::value_type;
+    using program_type = RegexConstexpr<Container, N>;
+    using context_type = MatchContext<Container, Alloc, N>;
     explicit Regex(const Container &pattern,
-                   const Vocabulary<value_type> &vocab) noexcept;
-    bool match(const Container &text) const noexcept;
+                   const Vocabulary<value_type> &vocab,
+                   const Construction construction = Construction::thompson,
+                   const Encoding encoding = Encoding::encoding_symbols,
+                   const Alloc &alloc = Alloc()) noexcept;
+    // False if the pattern was too long to compile or the program is not
+    // valid, see RegexConstexpr::valid(). Nothing matches then
+    bool valid() const noexcept;
+    // See RegexConstexpr::engine()
+    Engine engine(MatchMode mode = MatchMode::match_full) const noexcept;
+    // The compiled program, null when the pattern is longer than N
+    const program_type *program() const noexcept;
+    // A new context using the allocator of the regex
+    context_type context() const noexcept;
+    // Matches with a temporary scratch, which only allocates when the
+    // pattern needs the NFA. Pass a context to reuse it across matches
+    template <symbol_range<value_type> R>
+    bool match(R &&text, MatchMode mode = MatchMode::match_full) const
+        noexcept;
+    template <symbol_range<value_type> R>
+    bool match(R &&text, context_type &context,
+               MatchMode mode = MatchMode::match_full) const noexcept;
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+    std::optional<Match> find(R &&text, context_type &context) const noexcept;
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+                 && std::ranges::viewable_range<R>
+    MatchView<program_type, std::views::all_t<R>>
+    matches(R &&text, context_type &context) const noexcept;
+    // An invalid regex replaces nothing but still writes the text out, so
+    // that output meant to be redacted is not lost
+    template <symbol_range<value_type> R, symbol_range<value_type> S,
+              std::output_iterator<const value_type &> Out>
+        requires std::ranges::bidirectional_range<R>
+    ReplaceResult<Out> replace_all(R &&text, const S &replacement, Out out,
+                                   context_type &context) const noexcept;
+    template <std::size_t Lanes = 8, symbol_batch<value_type> B,
+              std::random_access_iterator Out>
+    void match_batch(const B &inputs, Out results, context_type &context,
+                     MatchMode mode = MatchMode::match_full) const noexcept;
+    // The figures of the program, which counts the scratch of one context,
+    // and the regex itself under other
+    MemoryUsage memory_usage() const noexcept;
 
   private:
-    const Vocabulary<value_type> _vocab;
-    const Alloc _alloc;
-    Container infix2postfix(const Container &pattern) const noexcept;
+    std::shared_ptr<const program_type> _program;
+    Alloc _alloc;
+    static VocabularyConstexpr<value_type>
+    compile_vocabulary(const Vocabulary<value_type> &vocab) noexcept;
 };
 
-template <class Container, class Alloc>
+template <class Container, class Alloc, std::size_t N>
 #if __cplusplus > 201703L // C++ 20
     requires std::default_initializable<Container>
 #endif
-Regex<Container, Alloc>::Regex(
+Regex<Container, Alloc, N>::Regex(
     const Container &pattern,
-    const Vocabulary<typename Container::value_type> &vocab) noexcept
-    : _vocab(vocab), _alloc()
+    const Vocabulary<typename Container::value_type> &vocab,
+    const Construction construction, const Encoding encoding,
+    const Alloc &alloc) noexcept
+    : _program(), _alloc(alloc)
 {
     static_assert(std::is_same<typename Alloc::value_type, value_type>::value,
                   "The allocator must have the same value_type as the "
                   "container's value_type");
 
-    // TODO: Check Correctness of the pattern
-    // TODO: Expand the pattern
+    if (std::ranges::size(pattern) > N)
+    {
+        return;
+    }
+    // Built in place, the program is too large to be moved around
+    using allocator_type =
+        std::allocator_traits<Alloc>::template rebind_alloc<program_type>;
+    _program = std::allocate_shared<program_type>(
+        allocator_type(_alloc), pattern, compile_vocabulary(vocab),
+        construction, encoding);
+}
 
-    [[maybe_unused]] Container rpn = infix2postfix(pattern);
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+bool Regex<Container, Alloc, N>::valid() const noexcept
+{
+    return _program != nullptr && _program->valid();
+}
 
-    // TODO: Thompson's construction
-    // TODO: NFA to DFA
-    // TODO: Minimize the DFA
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+Engine Regex<Container, Alloc, N>::engine(MatchMode mode) const noexcept
+{
+    return valid() ? _program->engine(mode) : Engine::engine_none;
 }
 
-template <class Container, class Alloc>
+template <class Container, class Alloc, std::size_t N>
 #if __cplusplus > 201703L // C++ 20
     requires std::default_initializable<Container>
 #endif
-bool Regex<Container, Alloc>::match(const Container &text) const noexcept
+const Regex<Container, Alloc, N>::program_type *
+Regex<Container, Alloc, N>::program() const noexcept
 {
-    // TODO: Match the text with the pattern
-    return false;
+    return _program.get();
 }
 
-template <class Container, class Alloc>
+template <class Container, class Alloc, std::size_t N>
 #if __cplusplus > 201703L // C++ 20
     requires std::default_initializable<Container>
 #endif
-Container
-Regex<Container, Alloc>::infix2postfix(const Container &pattern) const noexcept
+Regex<Container, Alloc, N>::context_type
+Regex<Container, Alloc, N>::context() const noexcept
 {
-    [[maybe_unused]] std::stack<value_type, std::deque<value_type, Alloc>>
-        stack;
+    return context_type(_alloc);
+}
 
-    // TODO: Implement the infix to postfix algorithm
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+bool Regex<Container, Alloc, N>::match(R &&text, MatchMode mode) const noexcept
+{
+    return valid() && _program->match(std::forward<R>(text), mode);
+}
 
-    return pattern;
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+bool Regex<Container, Alloc, N>::match(R &&text, context_type &context,
+                                       MatchMode mode) const noexcept
+{
+    return valid()
+           && _program->match(std::forward<R>(text), context.scratch(), mode);
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+std::optional<Match>
+Regex<Container, Alloc, N>::find(R &&text, context_type &context) const
+    noexcept
+{
+    if (!valid())
+    {
+        return std::nullopt;
+    }
+    return _program->find(std::forward<R>(text), context.scratch());
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+             && std::ranges::viewable_range<R>
+MatchView<typename Regex<Container, Alloc, N>::program_type,
+          std::views::all_t<R>>
+Regex<Container, Alloc, N>::matches(R &&text, context_type &context) const
+    noexcept
+{
+    return {_program.get(), std::views::all(std::forward<R>(text)),
+            &context.scratch()};
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R,
+          symbol_range<typename Container::value_type> S,
+          std::output_iterator<const typename Container::value_type &> Out>
+    requires std::ranges::bidirectional_range<R>
+ReplaceResult<Out>
+Regex<Container, Alloc, N>::replace_all(R &&text, const S &replacement,
+                                        Out out, context_type &context) const
+    noexcept
+{
+    if (!valid())
+    {
+        for (const auto &symbol : text)
+        {
+            *out++ = static_cast<value_type>(symbol);
+        }
+        return {std::move(out), 0};
+    }
+    return _program->replace_all(std::forward<R>(text), replacement,
+                                 std::move(out), context.scratch());
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <std::size_t Lanes, symbol_batch<typename Container::value_type> B,
+          std::random_access_iterator Out>
+void Regex<Container, Alloc, N>::match_batch(const B &inputs, Out results,
+                                             context_type &context,
+                                             MatchMode mode) const noexcept
+{
+    if (!valid())
+    {
+        std::size_t index = 0;
+        for ([[maybe_unused]] const auto &input : inputs)
+        {
+            results[static_cast<std::iter_difference_t<Out>>(index++)] = false;
+        }
+        return;
+    }
+    _program->template match_batch<Lanes>(inputs, std::move(results),
+                                          context.scratch(), mode);
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+MemoryUsage Regex<Container, Alloc, N>::memory_usage() const noexcept
+{
+    MemoryUsage usage = {};
+    if (valid())
+    {
+        usage = _program->memory_usage();
+    }
+    usage.other += {sizeof(*this), sizeof(*this)};
+    return usage;
+}
+
+template <class Container, class Alloc, std::size_t N>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+VocabularyConstexpr<typename Container::value_type>
+Regex<Container, Alloc, N>::compile_vocabulary(
+    const Vocabulary<value_type> &vocab) noexcept
+{
+    std::array<value_type, Operators::_op_max> operators = {};
+    std::array<bool, Operators::_op_max> defined = {};
+    for (std::size_t op = 0; op < Operators::_op_max; ++op)
+    {
+        operators[op] = vocab.get(static_cast<Operators>(op));
+        defined[op] = vocab.has(static_cast<Operators>(op));
+    }
+    return VocabularyConstexpr<value_type>(operators, defined);
 }
 
 } // namespace regez
@@ -26,16 +26,30 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <initializer_list>
+#include <istream>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <ostream>
+#include <ranges>
+#include <type_traits>
 #include <utility>
+#include <vector>
 #if __cplusplus > 201703L // C++ 17
 #include <concepts>
 #endif
 
+#include <regez/ast.hpp>
+#include <regez/char_class.hpp>
 #include <regez/constexpr_stack.hpp>
 #include <regez/constexpr_vector.hpp>
+#include <regez/dfa.hpp>
+#include <regez/index_set.hpp>
+#include <regez/memory_usage.hpp>
+#include <regez/literal_trie.hpp>
 #include <regez/operators.hpp>
 
 namespace regez
@@ -60,29 +74,75 @@ constexpr T pow(const T _base, const T _exp)
     return result;
 }
 
+// The operators of a list are given in the order of Operators, those left
+// out are not operators at all and their tokens are plain symbols
 template <class Type> class VocabularyConstexpr
 {
   public:
     using value_type = Type;
     constexpr VocabularyConstexpr(
         std::array<value_type, Operators::_op_max> vocab) noexcept
-        : _vocab(vocab)
+        : _vocab(vocab), _defined()
     {
+        _defined.fill(true);
     }
+    constexpr VocabularyConstexpr(
+        std::array<value_type, Operators::_op_max> vocab,
+        std::array<bool, Operators::_op_max> defined) noexcept
+        : _vocab(vocab), _defined(defined)
+    {
+    }
+    constexpr VocabularyConstexpr(
+        std::initializer_list<value_type> vocab) noexcept;
     constexpr value_type get(const Operators op) const noexcept;
+    // Whether the vocabulary gives a token to the operator
+    constexpr bool has(const Operators op) const noexcept;
 
   private:
-    const std::array<value_type, Operators::_op_max> _vocab;
+    std::array<value_type, Operators::_op_max> _vocab;
+    std::array<bool, Operators::_op_max> _defined;
 };
 
+template <class Type>
+constexpr VocabularyConstexpr<Type>::VocabularyConstexpr(
+    std::initializer_list<value_type> vocab) noexcept
+    : _vocab(), _defined()
+{
+    std::size_t op = 0;
+    for (const auto &token : vocab)
+    {
+        if (op == Operators::_op_max)
+        {
+            break;
+        }
+        _vocab[op] = token;
+        _defined[op++] = true;
+    }
+}
+
 template <class Type>
 constexpr Type VocabularyConstexpr<Type>::get(const Operators op) const noexcept
 {
     return _vocab[op];
 }
 
+template <class Type>
+constexpr bool VocabularyConstexpr<Type>::has(const Operators op) const noexcept
+{
+    return _defined[op];
+}
+
 typedef long unsigned int StateID;
 
+// Operation performed on a counter register by an epsilon transition
+enum CounterAction
+{
+    counter_none = 0,
+    counter_reset, // enter the repetition
+    counter_loop,  // start another iteration of the repetition
+    counter_exit,  // leave the repetition
+};
+
 template <class T> class Transition
 {
   public:
@@ -91,413 +151,2405 @@ template <class T> class Transition
     StateID to;
     T symbol;
     bool epsilon;
+    CounterAction action;
+    std::size_t counter;
+    std::size_t char_class; // no_class when the transition reads symbol
 
     constexpr explicit Transition() noexcept = default;
     constexpr Transition(StateID from, StateID to, bool epsilon,
-                         T symbol = T()) noexcept;
+                         T symbol = T(),
+                         CounterAction action = CounterAction::counter_none,
+                         std::size_t counter = 0,
+                         std::size_t char_class = no_class) noexcept;
 };
 
 template <class T>
 constexpr Transition<T>::Transition(StateID _from, StateID _to, bool _epsilon,
-                                    T _symbol) noexcept
-    : from(_from), to(_to), symbol(_symbol), epsilon(_epsilon)
+                                    T _symbol, CounterAction _action,
+                                    std::size_t _counter,
+                                    std::size_t _char_class) noexcept
+    : from(_from), to(_to), symbol(_symbol), epsilon(_epsilon),
+      action(_action), counter(_counter), char_class(_char_class)
 {
 }
 
-template <class T, std::size_t N> class StateMachine
+// A state of the NFA together with the value of every counter register
+template <std::size_t K> struct Configuration
+{
+    StateID state;
+    std::array<std::size_t, K> counters;
+
+    constexpr bool operator==(const Configuration &) const noexcept = default;
+};
+
+// Dense numbering of the configurations of a counting NFA, so that a set of
+// them is a bitmap. A counter is zero outside the body of its repetition,
+// so a state has one configuration per combination of the values of the
+// counters around it. A counter ranges over [0, max), or [0, min] without
+// an upper bound. S is the maximum number of states, K of counters
+template <std::size_t S, std::size_t K> class ConfigurationNumbering
+{
+  public:
+    // Past this many configurations a pattern is rejected, the working sets
+    // of a match would not fit in memory
+    constexpr static std::size_t max_configurations = std::size_t(1) << 24;
+    constexpr explicit ConfigurationNumbering() noexcept = default;
+    // Numbers the configurations of an indexed machine, and of the machine
+    // reversed from it, whose new initial state comes last. False when there
+    // are too many of them
+    template <class Machine> constexpr bool build(const Machine &sm) noexcept;
+    constexpr std::size_t size() const noexcept
+    {
+        return _offsets[_states];
+    }
+    constexpr std::size_t
+    index(const Configuration<K> &configuration) const noexcept;
+    constexpr Configuration<K> configuration(std::size_t index) const
+        noexcept;
+    constexpr StateID state(std::size_t index) const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    constexpr static std::size_t no_counter =
+        std::numeric_limits<std::size_t>::max();
+    std::size_t _states = 0;
+    // First configuration of each state, the last one is the total
+    std::array<std::size_t, S + 1> _offsets = {};
+    // Counter of the innermost repetition around each state
+    std::array<std::size_t, S> _innermost = {};
+    // Counter of the repetition around each repetition
+    std::array<std::size_t, K> _parent = {};
+    // The counter of an inner repetition varies slowest
+    std::array<std::size_t, K> _stride = {};
+    std::array<std::size_t, K> _range = {};
+};
+
+// N is the maximum number of states, M the maximum number of transitions and
+// R the maximum number of ranges of a character class
+template <class T, std::size_t N, std::size_t M = N * N, std::size_t R = N>
+class StateMachine
 {
   public:
     using value_type = T;
+    using char_class_type = CharClass<T, R>;
+    constexpr static std::size_t max_states = N;
+    constexpr static std::size_t max_transitions = M;
     constexpr explicit StateMachine() noexcept = default;
     constexpr StateID add_state() noexcept;
     constexpr void add_transition(StateID from, StateID to, T symbol) noexcept;
     constexpr void add_epsilon_transition(StateID from, StateID to) noexcept;
+    constexpr std::size_t add_class(const char_class_type &cls) noexcept;
+    constexpr void add_class_transition(StateID from, StateID to,
+                                        std::size_t cls) noexcept;
+    constexpr bool accepts(const Transition<T> &transition,
+                           const T &symbol) const noexcept;
+    constexpr std::size_t add_counter(std::size_t min,
+                                      std::size_t max) noexcept;
+    constexpr void add_counter_transition(StateID from, StateID to,
+                                          std::size_t counter,
+                                          CounterAction action) noexcept;
+    constexpr void epsilon_closure(IndexSet &states) const noexcept;
+    template <class Numbering>
+    constexpr void epsilon_closure(IndexSet &configurations,
+                                   const Numbering &numbering,
+                                   std::size_t from = 0) const noexcept;
+    template <std::size_t C>
+    constexpr bool
+    update_counters(const Transition<T> &transition,
+                    std::array<std::size_t, C> &counters) const noexcept;
+    constexpr StateMachine reversed() const noexcept;
+    // Groups the transitions by source state so that a step only looks at
+    // the transitions of the active states, and sorts those reading a single
+    // symbol to find them by binary search. To be called once the machine is
+    // complete, adding transitions afterwards drops the index
+    constexpr void index() noexcept;
+    // Calls visit with every transition leaving state that reads symbol
+    template <class F>
+    constexpr void for_each_move(const StateID state, const T &symbol,
+                                 F &&visit) const noexcept;
+    // Adds the machine to the NFA parts of usage
+    constexpr void memory_usage(MemoryUsage &usage) const noexcept;
 #ifndef REGEZ_DEBUG
   private:
 #endif
+    template <class, std::size_t, std::size_t, DfaLayout> friend class Dfa;
+    template <class, std::size_t, std::size_t, std::size_t, std::size_t>
+    friend class Lexer;
+    template <std::size_t, std::size_t> friend class ConfigurationNumbering;
+    template <class Container, std::size_t K, std::size_t L>
+#if __cplusplus > 201703L // C++ 20
+        requires std::default_initializable<Container>
+#endif
+    friend class RegexConstexpr;
+
     ConstexprVector<StateID, N> _states;
-    ConstexprVector<Transition<T>, N * N> _transitions;
+    ConstexprVector<Transition<T>, M> _transitions;
     ConstexprVector<StateID, N> _final_states;
+    ConstexprVector<Counter, N> _counters;
+    ConstexprVector<char_class_type, N / 4 + 1> _classes;
     StateID _initial_state;
+    // Once indexed, the transitions leaving state s are the epsilon ones from
+    // _first_transition[s], then those reading a class, then those reading a
+    // single symbol up to _first_transition[s + 1]
+    bool _indexed = false;
+    std::array<std::size_t, N + 1> _first_transition = {};
+    std::array<std::size_t, N> _first_class_transition = {};
+    std::array<std::size_t, N> _first_symbol_transition = {};
+
+    constexpr std::pair<std::size_t, std::size_t>
+    epsilon_transitions(const StateID state) const noexcept;
+    constexpr std::size_t find_symbol(std::size_t first, std::size_t last,
+                                      const T &symbol) const noexcept;
 };
 
-template <class T, std::size_t N>
-constexpr StateID StateMachine<T, N>::add_state() noexcept
+// The body of a repetition is what its reset transition reaches without
+// leaving through its exit transition. Bodies nest, the innermost around a
+// state is the smallest one holding it
+template <std::size_t S, std::size_t K>
+template <class Machine>
+constexpr bool ConfigurationNumbering<S, K>::build(const Machine &sm) noexcept
+{
+    _states = sm._states.size() + 1;
+    _innermost.fill(no_counter);
+    _parent.fill(no_counter);
+    std::array<std::size_t, K> body_size = {};
+    for (std::size_t counter = 0; counter < sm._counters.size(); ++counter)
+    {
+        const Counter bounds = sm._counters[counter];
+        _range[counter] = (bounds.max == repeat_unbounded)
+                              ? bounds.min + 1
+                              : std::max<std::size_t>(bounds.max, 1);
+        std::array<bool, S> inside = {};
+        ConstexprStack<StateID, S> work;
+        for (const auto &transition : sm._transitions)
+        {
+            if (transition.action == CounterAction::counter_reset
+                && transition.counter == counter && !inside[transition.to])
+            {
+                inside[transition.to] = true;
+                work.push(transition.to);
+            }
+        }
+        while (!work.empty())
+        {
+            const StateID state = work.top();
+            work.pop();
+            ++body_size[counter];
+            for (std::size_t t = sm._first_transition[state];
+                 t < sm._first_transition[state + 1]; ++t)
+            {
+                const auto &transition = sm._transitions[t];
+                if ((transition.action == CounterAction::counter_exit
+                     && transition.counter == counter)
+                    || inside[transition.to])
+                {
+                    continue;
+                }
+                inside[transition.to] = true;
+                work.push(transition.to);
+            }
+        }
+        for (StateID state = 0; state < sm._states.size(); ++state)
+        {
+            if (inside[state]
+                && (_innermost[state] == no_counter
+                    || body_size[counter] < body_size[_innermost[state]]))
+            {
+                _innermost[state] = counter;
+            }
+        }
+    }
+    // A reset leaves from the body of the repetition around
+    for (const auto &transition : sm._transitions)
+    {
+        if (transition.action == CounterAction::counter_reset)
+        {
+            _parent[transition.counter] = _innermost[transition.from];
+        }
+    }
+    for (std::size_t counter = 0; counter < sm._counters.size(); ++counter)
+    {
+        std::size_t stride = 1;
+        for (std::size_t outer = _parent[counter]; outer != no_counter;
+             outer = _parent[outer])
+        {
+            if (stride > max_configurations / _range[outer])
+            {
+                return false;
+            }
+            stride *= _range[outer];
+        }
+        _stride[counter] = stride;
+    }
+
+    _offsets[0] = 0;
+    for (StateID state = 0; state < _states; ++state)
+    {
+        const std::size_t counter = _innermost[state];
+        std::size_t count = 1;
+        if (counter != no_counter)
+        {
+            if (_stride[counter] > max_configurations / _range[counter])
+            {
+                return false;
+            }
+            count = _stride[counter] * _range[counter];
+        }
+        if (count > max_configurations - _offsets[state])
+        {
+            return false;
+        }
+        _offsets[state + 1] = _offsets[state] + count;
+    }
+    return true;
+}
+
+template <std::size_t S, std::size_t K>
+constexpr std::size_t ConfigurationNumbering<S, K>::index(
+    const Configuration<K> &configuration) const noexcept
+{
+    std::size_t index = _offsets[configuration.state];
+    for (std::size_t counter = _innermost[configuration.state];
+         counter != no_counter; counter = _parent[counter])
+    {
+        index += configuration.counters[counter] * _stride[counter];
+    }
+    return index;
+}
+
+template <std::size_t S, std::size_t K>
+constexpr StateID
+ConfigurationNumbering<S, K>::state(std::size_t index) const noexcept
+{
+    const auto first = _offsets.begin();
+    return static_cast<StateID>(
+        std::upper_bound(first, first + _states + 1, index) - first - 1);
+}
+
+template <std::size_t S, std::size_t K>
+constexpr Configuration<K>
+ConfigurationNumbering<S, K>::configuration(std::size_t index) const noexcept
+{
+    Configuration<K> configuration = {state(index), {}};
+    std::size_t rest = index - _offsets[configuration.state];
+    for (std::size_t counter = _innermost[configuration.state];
+         counter != no_counter; counter = _parent[counter])
+    {
+        configuration.counters[counter] = rest / _stride[counter];
+        rest %= _stride[counter];
+    }
+    return configuration;
+}
+
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr StateID StateMachine<T, N, M, R>::add_state() noexcept
 {
     StateID new_state = _states.size();
     _states.push_back(new_state);
     return new_state;
 }
 
-template <class T, std::size_t N>
-constexpr void StateMachine<T, N>::add_transition(StateID from, StateID to,
-                                                  T symbol) noexcept
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void StateMachine<T, N, M, R>::add_transition(StateID from, StateID to,
+                                                     T symbol) noexcept
 {
+    _indexed = false;
     Transition<T> new_transition(from, to, false, symbol);
     _transitions.push_back(new_transition);
     return;
 }
 
-template <class T, std::size_t N>
-constexpr void StateMachine<T, N>::add_epsilon_transition(StateID from,
-                                                          StateID to) noexcept
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void
+StateMachine<T, N, M, R>::add_epsilon_transition(StateID from, StateID to) noexcept
 {
+    _indexed = false;
     Transition<T> new_transition(from, to, true);
     _transitions.push_back(new_transition);
     return;
 }
 
-template <class Container, std::size_t N>
-#if __cplusplus > 201703L // C++ 20
-    requires std::default_initializable<Container>
-#endif
-class RegexConstexpr
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr std::size_t
+StateMachine<T, N, M, R>::add_class(const char_class_type &cls) noexcept
 {
-  public:
-    using value_type = Container::value_type;
-    constexpr explicit RegexConstexpr(
-        const Container &pattern,
-        const VocabularyConstexpr<value_type> &vocab) noexcept;
-
-    template <std::size_t M>
-    constexpr bool match_nfa(const Container &input) const noexcept;
-#ifndef REGEZ_DEBUG
-  private:
-#endif
-    StateMachine<value_type, pow((std::size_t) 2, N)> _sm;
-    constexpr static ConstexprVector<value_type, N>
-    infix2postfix(const Container &pattern,
-                  const VocabularyConstexpr<value_type> &voc);
-    constexpr static StateMachine<value_type, pow((std::size_t) 2, N)>
-    thompson_construction(const ConstexprVector<value_type, N> &rpn,
-                          const VocabularyConstexpr<value_type> &voc) noexcept;
-};
+    std::size_t new_class = _classes.size();
+    _classes.push_back(cls);
+    return new_class;
+}
 
-template <class Container, std::size_t N>
-#if __cplusplus > 201703L // C++ 20
-    requires std::default_initializable<Container>
-#endif
-constexpr RegexConstexpr<Container, N>::RegexConstexpr(
-    const Container &pattern,
-    const VocabularyConstexpr<typename Container::value_type> &vocab) noexcept
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void StateMachine<T, N, M, R>::add_class_transition(
+    StateID from, StateID to, std::size_t cls) noexcept
 {
-    // TODO: Check Correctness of the pattern
-    // TODO: Expand the pattern
-
-    ConstexprVector<value_type, N> rpn = infix2postfix(pattern, vocab);
-
-    StateMachine<value_type, pow((std::size_t) 2, N)> sm =
-        thompson_construction(rpn, vocab);
-
-    // TODO: NFA to DFA
-    // TODO: Minimize the DFA
-
-    _sm = sm;
+    _indexed = false;
+    Transition<T> new_transition(from, to, false, T(),
+                                 CounterAction::counter_none, 0, cls);
+    _transitions.push_back(new_transition);
+    return;
 }
 
-template <class Container, std::size_t N>
-#if __cplusplus > 201703L // C++ 20
-    requires std::default_initializable<Container>
-#endif
-template <std::size_t M>
+// Whether the transition can be taken reading symbol
+template <class T, std::size_t N, std::size_t M, std::size_t R>
 constexpr bool
-RegexConstexpr<Container, N>::match_nfa(const Container &input) const noexcept
+StateMachine<T, N, M, R>::accepts(const Transition<T> &transition,
+                                  const T &symbol) const noexcept
 {
-    constexpr std::size_t n_states = pow((std::size_t) 2, N);
-    ConstexprStack<StateID, n_states> current_states;
-    current_states.push(_sm._initial_state);
-
-    ConstexprVector<StateID, n_states> visited_states;
-    ConstexprVector<value_type, M> values;
-    for (const auto &v : input)
+    if (transition.epsilon)
     {
-        values.push_back(v);
+        return false;
     }
+    if (transition.char_class != no_class)
+    {
+        return _classes[transition.char_class].contains(symbol);
+    }
+    return transition.symbol == symbol;
+}
+
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr std::size_t StateMachine<T, N, M, R>::add_counter(std::size_t min,
+                                                         std::size_t max) noexcept
+{
+    std::size_t new_counter = _counters.size();
+    _counters.push_back(Counter{min, max});
+    return new_counter;
+}
+
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void StateMachine<T, N, M, R>::add_counter_transition(
+    StateID from, StateID to, std::size_t counter, CounterAction action) noexcept
+{
+    _indexed = false;
+    Transition<T> new_transition(from, to, true, T(), action, counter);
+    _transitions.push_back(new_transition);
+    return;
+}
 
-    for (std::size_t i = 0; i <= values.size(); ++i)
+// Extends the set of states with every state reachable through
+// epsilon transitions. The set is its own work list: the states appended
+// to it are visited in turn
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void
+StateMachine<T, N, M, R>::epsilon_closure(IndexSet &states) const noexcept
+{
+    for (std::size_t i = 0; i < states.size(); ++i)
     {
-        if (i == values.size()) // End of input
+        const StateID current_state = states[i];
+        const auto [first, last] = epsilon_transitions(current_state);
+        for (std::size_t t = first; t < last; ++t)
         {
-            for (const auto &state : current_states)
+            const Transition<T> &transition = _transitions[t];
+            if (transition.from == current_state && transition.epsilon)
             {
-                if (_sm._final_states.contains(state))
-                {
-                    return true;
-                }
+                states.insert(transition.to);
             }
-            return false;
         }
+    }
+}
 
-        ConstexprStack<StateID, pow((std::size_t) 2, N)> next_states;
-        for (const auto &state : current_states)
+// Same as above over configurations, stored by their number, following the
+// counter actions of the transitions. Only the configurations from the given
+// one in the order they were added are extended
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+template <class Numbering>
+constexpr void
+StateMachine<T, N, M, R>::epsilon_closure(IndexSet &configurations,
+                                          const Numbering &numbering,
+                                          std::size_t from) const noexcept
+{
+    for (std::size_t i = from; i < configurations.size(); ++i)
+    {
+        const auto current = numbering.configuration(configurations[i]);
+        const auto [first, last] = epsilon_transitions(current.state);
+        for (std::size_t t = first; t < last; ++t)
         {
-            for (const auto &transition : _sm._transitions)
+            const Transition<T> &transition = _transitions[t];
+            if (transition.from != current.state || !transition.epsilon)
             {
-                if (transition.from == state)
-                {
-                    if (transition.epsilon)
-                    {
-                        // Calculate closure
-                        ConstexprStack<StateID, N> closure;
-                        closure.push(transition.to);
-                        while (!closure.empty())
-                        {
-                            StateID current_state = closure.top();
-                            closure.pop();
-                            if (!visited_states.contains(current_state))
-                            {
-                                visited_states.push_back(current_state);
-                                for (const auto &next_transition :
-                                     _sm._transitions)
-                                {
-                                    if (next_transition.from == current_state
-                                        && next_transition.epsilon)
-                                    {
-                                        closure.push(next_transition.to);
-                                    }
-                                }
-                            }
-                        }
-                        for (const auto &a_state : visited_states)
-                        {
-                            next_states.push(a_state);
-                        }
-                    }
-                    else if (transition.symbol == values[i])
-                    {
-                        next_states.push(transition.to);
-                    }
-                }
+                continue;
+            }
+            auto next = current;
+            next.state = transition.to;
+            if (update_counters(transition, next.counters))
+            {
+                configurations.insert(numbering.index(next));
             }
-        }
-        current_states.clear();
-        for (const auto &a_state : next_states)
-        {
-            current_states.push(a_state);
         }
     }
-
-    return false;
 }
 
-// Assuming a well-formed pattern with no open match or close match tokens
-template <class Container, std::size_t N>
-#if __cplusplus > 201703L // C++ 20
-    requires std::default_initializable<Container>
-#endif
-constexpr ConstexprVector<typename Container::value_type, N>
-RegexConstexpr<Container, N>::infix2postfix(
-    const Container &pattern, const VocabularyConstexpr<value_type> &voc)
+// Applies the action of a transition to the counter registers, returns false
+// when the bounds of the counter forbid the transition
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+template <std::size_t C>
+constexpr bool StateMachine<T, N, M, R>::update_counters(
+    const Transition<T> &transition,
+    std::array<std::size_t, C> &counters) const noexcept
 {
-    regez::ConstexprVector<value_type, N> postfix;
-    regez::ConstexprStack<Operators, N> ops;
-    bool is_escaped = false;
-    for (const auto &c : pattern)
+    if (transition.action == CounterAction::counter_none)
+    {
+        return true;
+    }
+    const Counter counter = _counters[transition.counter];
+    std::size_t &value = counters[transition.counter];
+    switch (transition.action)
     {
-        if (is_escaped)
+    case CounterAction::counter_reset:
+        value = 0;
+        return true;
+    case CounterAction::counter_loop:
+        if (counter.max != repeat_unbounded && value + 1 >= counter.max)
         {
-            postfix.push_back(voc.get(Operators::op_escape));
-            postfix.push_back(c);
-            is_escaped = false;
-            continue;
+            return false;
         }
-
-        if (c == voc.get(Operators::op_open_group))
+        // Without an upper bound every value past min behaves the same
+        value = (counter.max == repeat_unbounded && value + 1 > counter.min)
+                    ? counter.min
+                    : value + 1;
+        return true;
+    case CounterAction::counter_exit:
+        if (value + 1 < counter.min
+            || (counter.max != repeat_unbounded && value + 1 > counter.max))
         {
-            ops.push(Operators::op_open_group);
+            return false;
         }
-        else if (c == voc.get(Operators::op_close_group))
+        // Keep the registers of inactive counters canonical
+        value = 0;
+        return true;
+    default:
+        return true;
+    }
+}
+
+// Machine accepting the reversed sequences: every transition is turned
+// around and a new initial state leads to the former final states. Entering
+// a repetition from its end resets the counter, leaving it from its start
+// checks the bounds
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr StateMachine<T, N, M, R>
+StateMachine<T, N, M, R>::reversed() const noexcept
+{
+    StateMachine reversed = StateMachine();
+    reversed._states = _states;
+    reversed._counters = _counters;
+    reversed._classes = _classes;
+    for (Transition<T> transition : _transitions)
+    {
+        const StateID from = transition.from;
+        transition.from = transition.to;
+        transition.to = from;
+        if (transition.action == CounterAction::counter_reset)
         {
-            while (!ops.empty() && Operators::op_open_group != ops.top())
-            {
-                postfix.push_back(voc.get(ops.top()));
-                ops.pop();
-            }
-            ops.pop();
+            transition.action = CounterAction::counter_exit;
         }
-        else if (c == voc.get(Operators::op_escape))
+        else if (transition.action == CounterAction::counter_exit)
         {
-            is_escaped = true;
+            transition.action = CounterAction::counter_reset;
         }
-        else if (c == voc.get(Operators::op_any))
+        reversed._transitions.push_back(transition);
+    }
+    const StateID initial_state = reversed.add_state();
+    for (const auto &state : _final_states)
+    {
+        reversed.add_epsilon_transition(initial_state, state);
+    }
+    reversed._initial_state = initial_state;
+    reversed._final_states.push_back(_initial_state);
+    return reversed;
+}
+
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void StateMachine<T, N, M, R>::index() noexcept
+{
+    // Rank of a transition among those of its source state
+    constexpr auto kind = [](const Transition<T> &transition) -> int
+    {
+        if (transition.epsilon)
         {
-            if (ops.empty() || Operators::op_any > ops.top()
-                || ops.contains(Operators::op_open_group))
-            {
-                ops.push(Operators::op_any);
-            }
-            else
-            {
-                while (!ops.empty() && Operators::op_any <= ops.top())
-                {
-                    postfix.push_back(voc.get(ops.top()));
-                    ops.pop();
-                }
-                ops.push(Operators::op_any);
-            }
+            return 0;
         }
-        else if (c == voc.get(Operators::op_one_or_more))
+        return (transition.char_class != no_class) ? 1 : 2;
+    };
+    const std::size_t n_transitions = _transitions.size();
+    if (n_transitions != 0)
+    {
+        std::sort(&_transitions[0], &_transitions[0] + n_transitions,
+                  [kind](const Transition<T> &a, const Transition<T> &b)
+                  {
+                      if (a.from != b.from)
+                      {
+                          return a.from < b.from;
+                      }
+                      if (kind(a) != kind(b))
+                      {
+                          return kind(a) < kind(b);
+                      }
+                      if constexpr (std::totally_ordered<T>)
+                      {
+                          return kind(a) == 2 && a.symbol < b.symbol;
+                      }
+                      return false;
+                  });
+    }
+
+    std::size_t t = 0;
+    for (StateID state = 0; state < _states.size(); ++state)
+    {
+        _first_transition[state] = t;
+        while (t < n_transitions && _transitions[t].from == state
+               && kind(_transitions[t]) == 0)
         {
-            if (ops.empty() || Operators::op_one_or_more > ops.top()
-                || ops.contains(Operators::op_open_group))
-            {
-                ops.push(Operators::op_one_or_more);
-            }
-            else
-            {
-                while (!ops.empty() && Operators::op_one_or_more <= ops.top())
-                {
-                    postfix.push_back(voc.get(ops.top()));
-                    ops.pop();
-                }
-                ops.push(Operators::op_one_or_more);
-            }
+            ++t;
         }
-        else if (c == voc.get(Operators::op_or))
+        _first_class_transition[state] = t;
+        while (t < n_transitions && _transitions[t].from == state
+               && kind(_transitions[t]) == 1)
         {
-            if (ops.empty() || Operators::op_or > ops.top()
-                || ops.contains(Operators::op_open_group))
-            {
-                ops.push(Operators::op_or);
-            }
-            else
-            {
-                while (!ops.empty() && Operators::op_or <= ops.top())
-                {
-                    postfix.push_back(voc.get(ops.top()));
-                    ops.pop();
-                }
-                ops.push(Operators::op_or);
-            }
+            ++t;
         }
-        else if (c == voc.get(Operators::op_concat))
+        _first_symbol_transition[state] = t;
+        while (t < n_transitions && _transitions[t].from == state)
         {
-            if (ops.empty() || Operators::op_concat > ops.top()
-                || ops.contains(Operators::op_open_group))
-            {
-                ops.push(Operators::op_concat);
-            }
-            else
-            {
-                while (!ops.empty() && Operators::op_concat <= ops.top())
-                {
-                    postfix.push_back(voc.get(ops.top()));
-                    ops.pop();
-                }
-                ops.push(Operators::op_concat);
-            }
-        }
-        else
-        { // Terminal symbol
-            postfix.push_back(c);
+            ++t;
         }
     }
-    while (!ops.empty())
-    {
-        postfix.push_back(voc.get(ops.top()));
-        ops.pop();
-    }
-    return postfix;
+    _first_transition[_states.size()] = t;
+    _indexed = true;
 }
 
-template <class Container, std::size_t N>
-#if __cplusplus > 201703L // C++ 20
-    requires std::default_initializable<Container>
-#endif
-constexpr StateMachine<typename Container::value_type, pow((std::size_t) 2, N)>
-RegexConstexpr<Container, N>::thompson_construction(
-    const ConstexprVector<typename Container::value_type, N> &rpn,
-    const VocabularyConstexpr<typename Container::value_type> &voc) noexcept
+// The padding of the machine is counted with its states
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr void
+StateMachine<T, N, M, R>::memory_usage(MemoryUsage &usage) const noexcept
+{
+    const MemorySize transitions = {
+        _transitions.size() * sizeof(Transition<T>), sizeof(_transitions)};
+    const MemorySize classes = {
+        _classes.size() * sizeof(char_class_type)
+            + _counters.size() * sizeof(Counter),
+        sizeof(_classes) + sizeof(_counters)};
+    const std::size_t index =
+        _indexed ? (3 * _states.size() + 1) * sizeof(std::size_t) : 0;
+    usage.nfa_states += {(_states.size() + _final_states.size() + 1)
+                                 * sizeof(StateID)
+                             + sizeof(_indexed) + index,
+                         sizeof(*this) - transitions.reserved
+                             - classes.reserved};
+    usage.nfa_transitions += transitions;
+    usage.nfa_classes += classes;
+}
+
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+template <class F>
+constexpr void StateMachine<T, N, M, R>::for_each_move(const StateID state,
+                                                       const T &symbol,
+                                                       F &&visit) const
+    noexcept
 {
-    auto sm =
-        StateMachine<typename Container::value_type, pow((std::size_t) 2, N)>();
-    ConstexprStack<std::pair<StateID, StateID>, N> state_stack;
-    for (std::size_t i = 0; i < rpn.size(); ++i)
+    if (!_indexed)
     {
-        value_type s = rpn[i];
-        if (s == voc.get(Operators::op_any))
+        for (const auto &transition : _transitions)
         {
-            if (state_stack.empty()) // Not enough operands
+            if (transition.from == state && accepts(transition, symbol))
             {
-                return sm;
+                visit(transition);
             }
-
-            std::pair<StateID, StateID> regex = state_stack.top();
-            StateID state_from = sm.add_state();
-            StateID state_to = sm.add_state();
-            sm.add_epsilon_transition(state_from, regex.first);
-            sm.add_epsilon_transition(regex.second, state_to);
-            sm.add_epsilon_transition(state_from, state_to);
-            sm.add_epsilon_transition(regex.second, regex.first);
-            state_stack.push(std::make_pair(state_from, state_to));
         }
-        else if (s == voc.get(Operators::op_one_or_more))
-        {
-            if (state_stack.empty()) // Not enough operands
-            {
-                return sm;
-            }
+        return;
+    }
 
-            std::pair<StateID, StateID> regex = state_stack.top();
-            StateID state_from = sm.add_state();
-            StateID state_to = sm.add_state();
-            sm.add_epsilon_transition(state_from, regex.first);
-            sm.add_epsilon_transition(regex.second, state_to);
-            sm.add_epsilon_transition(regex.second, regex.first);
-            state_stack.push(std::make_pair(state_from, state_to));
+    for (std::size_t t = _first_class_transition[state];
+         t < _first_symbol_transition[state]; ++t)
+    {
+        if (_classes[_transitions[t].char_class].contains(symbol))
+        {
+            visit(_transitions[t]);
         }
-        else if (s == voc.get(Operators::op_or))
+    }
+    const std::size_t last = _first_transition[state + 1];
+    if constexpr (std::totally_ordered<T>)
+    {
+        for (std::size_t t =
+                 find_symbol(_first_symbol_transition[state], last, symbol);
+             t < last && _transitions[t].symbol == symbol; ++t)
         {
-            if (state_stack.size() < 2) // Not enough operands
-            {
-                return sm;
-            }
-
-            std::pair<StateID, StateID> regex_a = state_stack.top();
-            state_stack.pop();
-            std::pair<StateID, StateID> regex_b = state_stack.top();
-            state_stack.pop();
-
-            StateID state_from = sm.add_state();
-            StateID state_to = sm.add_state();
-            sm.add_epsilon_transition(state_from, regex_a.first);
-            sm.add_epsilon_transition(state_from, regex_b.first);
-            sm.add_epsilon_transition(regex_a.second, state_to);
-            sm.add_epsilon_transition(regex_b.second, state_to);
-            state_stack.push(std::make_pair(state_from, state_to));
+            visit(_transitions[t]);
         }
-        else if (s == voc.get(Operators::op_concat))
+    }
+    else
+    {
+        for (std::size_t t = _first_symbol_transition[state]; t < last; ++t)
         {
-            if (state_stack.size() < 2) // Not enough operands
+            if (_transitions[t].symbol == symbol)
             {
-                return sm;
+                visit(_transitions[t]);
             }
-
-            std::pair<StateID, StateID> regex_a = state_stack.top();
-            state_stack.pop();
-            std::pair<StateID, StateID> regex_b = state_stack.top();
-            state_stack.pop();
-            sm.add_epsilon_transition(regex_b.second, regex_a.first);
-            state_stack.push(std::make_pair(regex_b.first, regex_a.second));
-        }
-        else // Terminal symbol
-        {
-            StateID state_from = sm.add_state();
-            StateID state_to = sm.add_state();
-            sm.add_transition(state_from, state_to, s);
-            state_stack.push(std::make_pair(state_from, state_to));
         }
     }
-    if (state_stack.size() != 1)
+}
+
+// Range of the transitions to look at for the epsilon transitions of state,
+// all of them until the machine is indexed
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr std::pair<std::size_t, std::size_t>
+StateMachine<T, N, M, R>::epsilon_transitions(const StateID state) const
+    noexcept
+{
+    if (!_indexed)
     {
-        return sm;
+        return {0, _transitions.size()};
     }
-    std::pair<StateID, StateID> regex = state_stack.top();
-    sm._initial_state = regex.first;
-    sm._final_states.push_back(regex.second);
-    return sm;
+    return {_first_transition[state], _first_class_transition[state]};
 }
 
+// First transition in [first, last) whose symbol is not less than symbol,
+// the loop has no branch on the comparison
+template <class T, std::size_t N, std::size_t M, std::size_t R>
+constexpr std::size_t
+StateMachine<T, N, M, R>::find_symbol(std::size_t first, std::size_t last,
+                                      const T &symbol) const noexcept
+{
+    if (first == last)
+    {
+        return last;
+    }
+    std::size_t count = last - first;
+    while (count > 1)
+    {
+        const std::size_t half = count / 2;
+        first = (_transitions[first + half].symbol < symbol) ? first + half
+                                                             : first;
+        count -= half;
+    }
+    return (_transitions[first].symbol < symbol) ? first + 1 : first;
+}
+
+// How much of the input a match has to cover
+enum MatchMode
+{
+    match_full = 0, // the whole input
+    match_prefix,   // a prefix of the input, the longest one
+    match_shortest, // a prefix of the input, the shortest one
+    match_anywhere, // any part of the input, the one that ends first
+};
+
+// A range whose elements can be read as symbols of type T
+template <class R, class T>
+concept symbol_range =
+    std::ranges::input_range<R>
+    && std::convertible_to<std::ranges::range_reference_t<R>, T>;
+
+// A batch of inputs, each of them a range of symbols of type T that outlives
+// the iteration over the batch
+template <class B, class T>
+concept symbol_batch =
+    std::ranges::forward_range<B>
+    && symbol_range<std::ranges::range_reference_t<B>, T>
+    && std::ranges::borrowed_range<std::ranges::range_reference_t<B>>;
+
+// Span [begin, end) of a match in the input
+struct Match
+{
+    std::size_t begin;
+    std::size_t end;
+
+    constexpr bool operator==(const Match &) const noexcept = default;
+};
+
+// Where replace_all() stopped writing, and how many matches it replaced.
+// Nothing was written when none were: the input itself is the result
+template <class Out> struct ReplaceResult
+{
+    Out out;
+    std::size_t replaced;
+};
+
+template <class Regex, std::ranges::view V>
+    requires std::ranges::bidirectional_range<V>
+class MatchView;
+template <class Regex> class IncrementalMatcher;
+template <class Container, std::size_t N, std::size_t K, std::size_t S,
+          std::size_t A>
+class Lexer;
+
+// Algorithm used to build the NFA from the syntax tree
+enum Construction
+{
+    thompson = 0, // epsilon transitions, two states per symbol
+    glushkov,     // epsilon-free, one state per symbol plus the initial one
+};
+
+// Transitions that the Glushkov automaton of any pattern of n tokens fits
+// in, one per pair of positions. A RegexConstexpr holds 4 * n + 4 by default,
+// which is all Thompson's construction needs
+constexpr std::size_t glushkov_transitions(std::size_t n) noexcept
+{
+    return (n + 1) * (n + 1);
+}
+
+// Automaton a match runs over the input
+enum Engine
+{
+    engine_none = 0,     // the pattern is not valid, nothing runs
+    engine_literal,      // the trie of the literal alternatives
+    engine_dfa,          // a DFA
+    engine_counting_nfa, // the NFA, tracking the values of its counters
+    engine_nfa,          // the NFA
+};
+
+// N is the maximum number of tokens of the pattern and M the maximum number of
+// transitions of its NFA
+template <class Container, std::size_t N, std::size_t M = 4 * N + 4>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+class RegexConstexpr
+{
+    static_assert(M >= 4 * N + 4, "Thompson's construction may need 4 * N + 4 "
+                                  "transitions");
+
+  public:
+    using value_type = Container::value_type;
+    // Working sets of the NFA simulations, the overloads taking one reuse it
+    // instead of setting up their own
+    struct Scratch;
+    // With encoding_utf8, code points of a pattern over bytes match their
+    // UTF-8 encoding and inputs are matched as raw bytes
+    constexpr explicit RegexConstexpr(
+        const Container &pattern, const VocabularyConstexpr<value_type> &vocab,
+        const Construction construction = Construction::thompson,
+        const Encoding encoding = Encoding::encoding_symbols) noexcept;
+    // False when the pattern does not parse, its UTF-8 byte sequences do
+    // not fit in N, or a counted repetition has more configurations than a
+    // match can keep track of. Nothing matches then
+    constexpr bool valid() const noexcept;
+    // The automaton that finds where a match in the given mode ends, which
+    // find() and matches() run in match_anywhere
+    constexpr Engine engine(MatchMode mode = MatchMode::match_full) const
+        noexcept;
+
+    // Whether the input matches in the given mode. The input is read once,
+    // not copied, and only until the answer is known
+    template <symbol_range<value_type> R>
+    constexpr bool match(R &&input, MatchMode mode = MatchMode::match_full) const
+        noexcept;
+    template <symbol_range<value_type> R>
+    constexpr bool match(R &&input, Scratch &scratch,
+                         MatchMode mode = MatchMode::match_full) const noexcept;
+    // Offset where the match ends in the given mode
+    template <symbol_range<value_type> R>
+    constexpr std::optional<std::size_t> match_end(R &&input,
+                                                   MatchMode mode) const
+        noexcept;
+    template <symbol_range<value_type> R>
+    constexpr std::optional<std::size_t>
+    match_end(R &&input, Scratch &scratch, MatchMode mode) const noexcept;
+    template <std::size_t L>
+    constexpr bool match_nfa(const Container &input) const noexcept;
+    // Finds the leftmost match, the longest one from its start
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+    constexpr std::optional<Match> find(R &&input) const noexcept;
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+    constexpr std::optional<Match> find(R &&input, Scratch &scratch) const
+        noexcept;
+    // Every match that find() would report one after the other, each found
+    // only when the range gets to it. Matches do not overlap, and an empty
+    // match moves the search one symbol forward
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+                 && std::ranges::viewable_range<R>
+    constexpr MatchView<RegexConstexpr, std::views::all_t<R>>
+    matches(R &&input) const noexcept;
+    template <symbol_range<value_type> R>
+        requires std::ranges::bidirectional_range<R>
+                 && std::ranges::viewable_range<R>
+    constexpr MatchView<RegexConstexpr, std::views::all_t<R>>
+    matches(R &&input, Scratch &scratch) const noexcept;
+    // Writes the input to out with every match of matches() replaced, each
+    // unmatched symbol copied once as the search passes it. Nothing is
+    // written until the first match is found, so an input without one costs
+    // a single search and is left for the caller to use as it is
+    template <symbol_range<value_type> R, symbol_range<value_type> S,
+              std::output_iterator<const value_type &> Out>
+        requires std::ranges::bidirectional_range<R>
+    constexpr ReplaceResult<Out> replace_all(R &&input, const S &replacement,
+                                             Out out) const noexcept;
+    template <symbol_range<value_type> R, symbol_range<value_type> S,
+              std::output_iterator<const value_type &> Out>
+        requires std::ranges::bidirectional_range<R>
+    constexpr ReplaceResult<Out> replace_all(R &&input, const S &replacement,
+                                             Out out, Scratch &scratch) const
+        noexcept;
+    // Whether each input of the batch matches, written to results in the
+    // order of the batch. Lanes inputs advance through the DFA in lockstep
+    template <std::size_t Lanes = 8, symbol_batch<value_type> B,
+              std::random_access_iterator Out>
+    constexpr void match_batch(const B &inputs, Out results,
+                               MatchMode mode = MatchMode::match_full) const
+        noexcept;
+    template <std::size_t Lanes = 8, symbol_batch<value_type> B,
+              std::random_access_iterator Out>
+    constexpr void match_batch(const B &inputs, Out results, Scratch &scratch,
+                               MatchMode mode = MatchMode::match_full) const
+        noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    // Every construction needs at most two states per token of the pattern,
+    // Thompson's four transitions. Glushkov's follow sets may need one
+    // transition per pair of positions, see glushkov_transitions()
+    constexpr static std::size_t max_states = 2 * N + 2;
+    constexpr static std::size_t max_transitions = M;
+    // A counted repetition takes at least four tokens: x{m}
+    constexpr static std::size_t max_counters = N / 4 + 1;
+    // Past this many states matching falls back to the NFA
+    constexpr static std::size_t max_dfa_states = 2 * max_states;
+    // Every symbol or range splits at most one class in three, and there are
+    // no more classes than symbols
+    constexpr static std::size_t max_symbol_classes =
+        (sizeof(value_type) == 1) ? std::min<std::size_t>(2 * N + 2, 256)
+                                  : 2 * N + 2;
+    constexpr static std::size_t npos = std::numeric_limits<std::size_t>::max();
+    template <class> friend class IncrementalMatcher;
+    template <class, std::size_t, std::size_t, std::size_t, std::size_t>
+    friend class Lexer;
+    using ast_type = Ast<value_type, N>;
+    using state_machine_type =
+        StateMachine<value_type, max_states, max_transitions,
+                     ast_type::max_class_ranges>;
+    using dfa_type = Dfa<value_type, max_dfa_states, max_symbol_classes>;
+    using configuration_type = Configuration<max_counters>;
+    // The reversed machine adds an initial state
+    using numbering_type =
+        ConfigurationNumbering<max_states + 1, max_counters>;
+
+  public:
+    struct Scratch
+    {
+        // Sized to the pattern on first use, so that a scratch costs nothing
+        // until the NFA runs and is small enough for the stack
+        std::array<IndexSet, 2> states;
+        // Configurations by number, when the pattern has counters
+        std::array<IndexSet, 2> configurations;
+        // Where each group of configurations of a search ends in its set
+        std::array<std::vector<std::size_t>, 2> groups;
+    };
+    // Visits of the states of the DFA that match() runs, see Dfa::profile.
+    // Nothing is recorded when the pattern has no DFA
+    using profile_type = dfa_type::profile_type;
+    template <symbol_range<value_type> R>
+    constexpr void profile(R &&input, profile_type &visits) const noexcept;
+    // Puts the hottest states of the profile next to each other
+    constexpr void relayout(const profile_type &visits) noexcept;
+    constexpr DfaHeatmap<value_type, max_dfa_states, max_symbol_classes,
+                         default_dfa_layout>
+    heatmap(const profile_type &visits) const noexcept
+    {
+        return {_anchored, visits};
+    }
+    // Saves the layout of the DFA, loading it back into a regex of the same
+    // pattern skips profiling. load() fails on any other pattern
+    bool save(std::ostream &os) const;
+    bool load(std::istream &is);
+    // Bytes taken by the compiled pattern, a constant expression for a
+    // constexpr regex. The scratch is the one a match sets up when it is
+    // not given one, and is only used when the pattern has no DFA. Its
+    // reserved size counts the most its sets may grow to on the heap
+    constexpr MemoryUsage memory_usage() const noexcept;
+#ifndef REGEZ_DEBUG
+  private:
+#endif
+    struct GlushkovFragment
+    {
+        bool nullable;
+        ConstexprVector<StateID, N> first;
+        ConstexprVector<StateID, N> last;
+    };
+    state_machine_type _sm;
+    Construction _construction;
+    // Alternations of literals are matched by the trie instead of the NFA
+    LiteralTrie<value_type, N> _literals;
+    bool _literal;
+    // Searching runs forward to the end of a match, then backward from there
+    // to its start on the reversed machine
+    state_machine_type _reverse_sm;
+    dfa_type _forward;
+    dfa_type _reverse;
+    // Anchored at the start of the input, for the match modes
+    dfa_type _anchored;
+    numbering_type _numbering;
+    bool _valid;
+    template <class It, class Sentinel>
+    constexpr std::size_t run(It first, Sentinel last, MatchMode mode,
+                              bool need_end, Scratch &scratch) const noexcept;
+    template <class Automaton, class It, class Sentinel>
+    constexpr static std::size_t run_anchored(const Automaton &automaton,
+                                              It first, Sentinel last,
+                                              MatchMode mode,
+                                              bool need_end) noexcept;
+    template <class It, class Sentinel>
+    constexpr std::size_t run_nfa(It first, Sentinel last, MatchMode mode,
+                                  Scratch &scratch) const noexcept;
+    template <class It, class Sentinel>
+    constexpr std::size_t run_counting(It first, Sentinel last, MatchMode mode,
+                                       Scratch &scratch) const noexcept;
+    constexpr static void step(const state_machine_type &sm,
+                               const numbering_type &numbering,
+                               const IndexSet &current,
+                               const value_type symbol,
+                               IndexSet &next) noexcept;
+    template <class It, class Sentinel>
+    constexpr std::size_t find_end(It first, Sentinel last, bool longest,
+                                   Scratch &scratch) const noexcept;
+    template <class It, class Sentinel>
+    constexpr std::size_t find_end_nfa(It first, Sentinel last, bool longest,
+                                       Scratch &scratch) const noexcept;
+    template <class It>
+    constexpr std::size_t find_start_nfa(It it, const It first,
+                                         std::size_t end,
+                                         Scratch &scratch) const noexcept;
+    constexpr static ConstexprVector<value_type, N>
+    infix2postfix(const Container &pattern,
+                  const VocabularyConstexpr<value_type> &voc);
+    constexpr static state_machine_type
+    thompson_construction(const ConstexprVector<value_type, N> &rpn,
+                          const VocabularyConstexpr<value_type> &voc) noexcept;
+    constexpr static state_machine_type
+    thompson_construction(const ast_type &ast) noexcept;
+    constexpr static std::pair<StateID, StateID>
+    thompson_fragment(const ast_type &ast, std::size_t id,
+                      state_machine_type &sm) noexcept;
+    constexpr static state_machine_type
+    glushkov_construction(const ConstexprVector<value_type, N> &rpn,
+                          const VocabularyConstexpr<value_type> &voc) noexcept;
+    constexpr static state_machine_type
+    glushkov_construction(const ast_type &ast) noexcept;
+    constexpr static GlushkovFragment
+    glushkov_fragment(const ast_type &ast, std::size_t id,
+                      state_machine_type &sm,
+                      ConstexprVector<value_type, N + 1> &labels,
+                      ConstexprVector<std::size_t, N + 1> &label_classes)
+        noexcept;
+    constexpr static void
+    glushkov_merge(ConstexprVector<StateID, N> &into,
+                   const ConstexprVector<StateID, N> &from) noexcept;
+    constexpr static void
+    glushkov_follow(state_machine_type &sm,
+                    const ConstexprVector<value_type, N + 1> &labels,
+                    const ConstexprVector<std::size_t, N + 1> &label_classes,
+                    StateID from,
+                    const ConstexprVector<StateID, N> &to) noexcept;
+};
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::RegexConstexpr(
+    const Container &pattern,
+    const VocabularyConstexpr<typename Container::value_type> &vocab,
+    const Construction construction, const Encoding encoding) noexcept
+    : _construction(construction), _literals(), _literal(false),
+      _reverse_sm(), _forward(), _reverse(), _anchored(), _numbering(),
+      _valid(false)
+{
+    // TODO: Check Correctness of the pattern
+
+    const TokenClassifier<value_type> classifier(vocab);
+    ast_type ast = ast_type::from_infix(pattern, classifier, encoding);
+    // Before simplification, which would turn the literals into classes
+    _literal = _literals.build(ast);
+    ast.simplify();
+
+    // Counted repetitions need the epsilon transitions of Thompson's
+    // construction to carry their counter actions
+    if (ast.has(NodeKind::node_repeat))
+    {
+        _construction = Construction::thompson;
+    }
+
+    state_machine_type sm = (_construction == Construction::glushkov)
+                                ? glushkov_construction(ast)
+                                : thompson_construction(ast);
+    // A position automaton whose follow sets do not fit in M transitions is
+    // replaced by Thompson's, which always fits
+    if (_construction == Construction::glushkov
+        && sm._transitions.size() == max_transitions)
+    {
+        _construction = Construction::thompson;
+        sm = thompson_construction(ast);
+    }
+
+    // TODO: Minimize the DFA
+
+    _sm = sm;
+    _sm.index();
+    _reverse_sm = sm.reversed();
+    _reverse_sm.index();
+    _forward.build(_sm, true);
+    _reverse.build(_reverse_sm, false);
+    _anchored.build(_sm, false);
+    _valid = ast.valid() && _numbering.build(_sm);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr bool RegexConstexpr<Container, N, M>::valid() const noexcept
+{
+    return _valid;
+}
+
+// Follows the choices of run() and find_end()
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr Engine RegexConstexpr<Container, N, M>::engine(MatchMode mode) const
+    noexcept
+{
+    if (!_valid)
+    {
+        return Engine::engine_none;
+    }
+    if (_literal)
+    {
+        return Engine::engine_literal;
+    }
+    const bool dfa = (mode == MatchMode::match_anywhere) ? _forward.valid()
+                                                         : _anchored.valid();
+    if (dfa)
+    {
+        return Engine::engine_dfa;
+    }
+    return _sm._counters.empty() ? Engine::engine_nfa
+                                 : Engine::engine_counting_nfa;
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+constexpr bool RegexConstexpr<Container, N, M>::match(R &&input,
+                                                      MatchMode mode) const
+    noexcept
+{
+    Scratch scratch;
+    return match(std::forward<R>(input), scratch, mode);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+constexpr bool RegexConstexpr<Container, N, M>::match(R &&input,
+                                                      Scratch &scratch,
+                                                      MatchMode mode) const
+    noexcept
+{
+    // Any matching prefix answers, the shortest one is found first
+    if (mode == MatchMode::match_prefix)
+    {
+        mode = MatchMode::match_shortest;
+    }
+    return run(std::ranges::begin(input), std::ranges::end(input), mode,
+               false, scratch)
+           != npos;
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+constexpr std::optional<std::size_t>
+RegexConstexpr<Container, N, M>::match_end(R &&input, MatchMode mode) const
+    noexcept
+{
+    Scratch scratch;
+    return match_end(std::forward<R>(input), scratch, mode);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+constexpr std::optional<std::size_t>
+RegexConstexpr<Container, N, M>::match_end(R &&input, Scratch &scratch,
+                                           MatchMode mode) const noexcept
+{
+    const std::size_t end = run(std::ranges::begin(input),
+                                std::ranges::end(input), mode, true, scratch);
+    if (end == npos)
+    {
+        return std::nullopt;
+    }
+    return end;
+}
+
+// Kept for compatibility, the input is no longer copied so L is unused
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <std::size_t L>
+constexpr bool
+RegexConstexpr<Container, N, M>::match_nfa(const Container &input) const
+    noexcept
+{
+    return match(input);
+}
+
+// Returns the offset where the match ends, or npos. When need_end is false
+// the offset where the answer became known may be returned instead
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It, class Sentinel>
+constexpr std::size_t
+RegexConstexpr<Container, N, M>::run(It first, Sentinel last, MatchMode mode,
+                                     bool need_end, Scratch &scratch) const
+    noexcept
+{
+    if (!_valid)
+    {
+        return npos;
+    }
+    if (mode == MatchMode::match_anywhere)
+    {
+        return find_end(std::move(first), last, false, scratch);
+    }
+    if (_literal)
+    {
+        return run_anchored(_literals, std::move(first), last, mode,
+                            need_end);
+    }
+    if (_anchored.valid())
+    {
+        return run_anchored(_anchored, std::move(first), last, mode,
+                            need_end);
+    }
+    if (!_sm._counters.empty())
+    {
+        return run_counting(std::move(first), last, mode, scratch);
+    }
+    return run_nfa(std::move(first), last, mode, scratch);
+}
+
+// Runs a deterministic automaton from the start of the input and stops as
+// soon as it dies, or accepts in a state that accepts every continuation
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class Automaton, class It, class Sentinel>
+constexpr std::size_t RegexConstexpr<Container, N, M>::run_anchored(
+    const Automaton &automaton, It first, Sentinel last, MatchMode mode,
+    bool need_end) noexcept
+{
+    auto state = automaton.initial();
+    std::size_t end = npos;
+    for (std::size_t i = 0;; ++i, ++first)
+    {
+        if (automaton.dead(state))
+        {
+            return (mode == MatchMode::match_full) ? npos : end;
+        }
+        if (automaton.accepting(state))
+        {
+            end = i;
+            if (mode == MatchMode::match_shortest)
+            {
+                return end;
+            }
+            if (automaton.always_accepting(state))
+            {
+                // Any longer input matches as well
+                return need_end ? i + static_cast<std::size_t>(
+                                          std::ranges::distance(first, last))
+                                : i;
+            }
+        }
+        if (first == last)
+        {
+            return (mode == MatchMode::match_full && end != i) ? npos : end;
+        }
+        state = automaton.next(state, static_cast<value_type>(*first));
+    }
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It, class Sentinel>
+constexpr std::size_t
+RegexConstexpr<Container, N, M>::run_nfa(It first, Sentinel last,
+                                         MatchMode mode,
+                                         Scratch &scratch) const noexcept
+{
+    auto *current_states = &scratch.states[0];
+    auto *next_states = &scratch.states[1];
+    current_states->reset(_sm._states.size());
+    next_states->reset(_sm._states.size());
+    current_states->insert(_sm._initial_state);
+    if (_construction != Construction::glushkov)
+    {
+        _sm.epsilon_closure(*current_states);
+    }
+
+    std::size_t end = npos;
+    for (std::size_t i = 0;; ++i, ++first)
+    {
+        for (const auto &state : *current_states)
+        {
+            if (_sm._final_states.contains(state))
+            {
+                end = i;
+                break;
+            }
+        }
+        if (end == i && mode == MatchMode::match_shortest)
+        {
+            return end;
+        }
+        // No active state is left, the rest of the input does not matter
+        if (current_states->empty())
+        {
+            return (mode == MatchMode::match_full) ? npos : end;
+        }
+        if (first == last)
+        {
+            return (mode == MatchMode::match_full && end != i) ? npos : end;
+        }
+
+        const value_type symbol = static_cast<value_type>(*first);
+        next_states->clear();
+        for (const auto &state : *current_states)
+        {
+            _sm.for_each_move(
+                state, symbol,
+                [next_states](const Transition<value_type> &transition)
+                { next_states->insert(transition.to); });
+        }
+        // Glushkov automata have no epsilon transitions to follow
+        if (_construction != Construction::glushkov)
+        {
+            _sm.epsilon_closure(*next_states);
+        }
+        std::swap(current_states, next_states);
+    }
+}
+
+// Simulates the NFA tracking the value of the counter registers: a state may
+// be active several times with different counter values, but the automaton
+// itself does not grow with the repetition bounds
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It, class Sentinel>
+constexpr std::size_t RegexConstexpr<Container, N, M>::run_counting(
+    It first, Sentinel last, MatchMode mode, Scratch &scratch) const noexcept
+{
+    auto *current = &scratch.configurations[0];
+    auto *next = &scratch.configurations[1];
+    current->reset(_numbering.size());
+    next->reset(_numbering.size());
+    current->insert(
+        _numbering.index(configuration_type{_sm._initial_state, {}}));
+    _sm.epsilon_closure(*current, _numbering);
+
+    std::size_t end = npos;
+    for (std::size_t i = 0;; ++i, ++first)
+    {
+        for (const std::size_t configuration : *current)
+        {
+            if (_sm._final_states.contains(_numbering.state(configuration)))
+            {
+                end = i;
+                break;
+            }
+        }
+        if (end == i && mode == MatchMode::match_shortest)
+        {
+            return end;
+        }
+        if (current->empty())
+        {
+            return (mode == MatchMode::match_full) ? npos : end;
+        }
+        if (first == last)
+        {
+            return (mode == MatchMode::match_full && end != i) ? npos : end;
+        }
+
+        next->clear();
+        step(_sm, _numbering, *current, static_cast<value_type>(*first),
+             *next);
+        std::swap(current, next);
+    }
+}
+
+// Moves every configuration over symbol and adds what it reaches, closed
+// under epsilon transitions, to next
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr void RegexConstexpr<Container, N, M>::step(
+    const state_machine_type &sm, const numbering_type &numbering,
+    const IndexSet &current, const value_type symbol, IndexSet &next) noexcept
+{
+    for (const std::size_t index : current)
+    {
+        const configuration_type configuration =
+            numbering.configuration(index);
+        sm.for_each_move(
+            configuration.state, symbol,
+            [&numbering, &configuration,
+             &next](const Transition<value_type> &transition)
+            {
+                next.insert(numbering.index(configuration_type{
+                    transition.to, configuration.counters}));
+            });
+    }
+    sm.epsilon_closure(next, numbering);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+constexpr std::optional<Match>
+RegexConstexpr<Container, N, M>::find(R &&input) const noexcept
+{
+    Scratch scratch;
+    return find(std::forward<R>(input), scratch);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+constexpr std::optional<Match>
+RegexConstexpr<Container, N, M>::find(R &&input, Scratch &scratch) const
+    noexcept
+{
+    const auto first = std::ranges::begin(input);
+    const auto last = std::ranges::end(input);
+    if (_valid && _literal)
+    {
+        // A literal that starts before the one ending first ends after it,
+        // so it starts less than the longest literal before that end
+        const std::size_t first_end = _literals.find_end(first, last);
+        if (first_end == npos)
+        {
+            return std::nullopt;
+        }
+        std::size_t start =
+            first_end - std::min(first_end, _literals.longest());
+        auto it = std::ranges::next(
+            first, static_cast<std::ranges::range_difference_t<R>>(start));
+        for (;; ++start, ++it)
+        {
+            const std::size_t length = _literals.prefix_end(it, last);
+            if (length != npos)
+            {
+                return Match{start, start + length};
+            }
+        }
+    }
+    const std::size_t end = find_end(first, last, true, scratch);
+    if (end == npos)
+    {
+        return std::nullopt;
+    }
+
+    auto it = std::ranges::next(
+        first, static_cast<std::ranges::range_difference_t<R>>(end));
+    if (!_reverse.valid())
+    {
+        return Match{find_start_nfa(std::move(it), first, end, scratch), end};
+    }
+    std::size_t start = end;
+    typename dfa_type::state_type state = _reverse.initial();
+    for (std::size_t i = end; i > 0; --i)
+    {
+        state = _reverse.next(state, static_cast<value_type>(*--it));
+        if (_reverse.dead(state))
+        {
+            break;
+        }
+        if (_reverse.accepting(state))
+        {
+            start = i - 1;
+        }
+    }
+    return Match{start, end};
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+             && std::ranges::viewable_range<R>
+constexpr MatchView<RegexConstexpr<Container, N, M>, std::views::all_t<R>>
+RegexConstexpr<Container, N, M>::matches(R &&input) const noexcept
+{
+    return {this, std::views::all(std::forward<R>(input)), nullptr};
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+    requires std::ranges::bidirectional_range<R>
+             && std::ranges::viewable_range<R>
+constexpr MatchView<RegexConstexpr<Container, N, M>, std::views::all_t<R>>
+RegexConstexpr<Container, N, M>::matches(R &&input, Scratch &scratch) const
+    noexcept
+{
+    return {this, std::views::all(std::forward<R>(input)), &scratch};
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R,
+          symbol_range<typename Container::value_type> S,
+          std::output_iterator<const typename Container::value_type &> Out>
+    requires std::ranges::bidirectional_range<R>
+constexpr ReplaceResult<Out>
+RegexConstexpr<Container, N, M>::replace_all(R &&input, const S &replacement,
+                                             Out out) const noexcept
+{
+    Scratch scratch;
+    return replace_all(std::forward<R>(input), replacement, std::move(out),
+                       scratch);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R,
+          symbol_range<typename Container::value_type> S,
+          std::output_iterator<const typename Container::value_type &> Out>
+    requires std::ranges::bidirectional_range<R>
+constexpr ReplaceResult<Out>
+RegexConstexpr<Container, N, M>::replace_all(R &&input, const S &replacement,
+                                             Out out, Scratch &scratch) const
+    noexcept
+{
+    auto position = std::ranges::begin(input);
+    const auto last = std::ranges::end(input);
+    std::size_t replaced = 0;
+    while (true)
+    {
+        const std::optional<Match> found =
+            find(std::ranges::subrange(position, last), scratch);
+        if (!found)
+        {
+            break;
+        }
+        for (std::size_t i = 0; i < found->begin; ++i, ++position)
+        {
+            *out++ = static_cast<value_type>(*position);
+        }
+        for (const auto &symbol : replacement)
+        {
+            *out++ = static_cast<value_type>(symbol);
+        }
+        ++replaced;
+        if (found->begin != found->end)
+        {
+            std::ranges::advance(
+                position, static_cast<std::ranges::range_difference_t<R>>(
+                              found->end - found->begin));
+            continue;
+        }
+        // An empty match keeps the symbol after it and moves past it
+        if (position == last)
+        {
+            return {std::move(out), replaced};
+        }
+        *out++ = static_cast<value_type>(*position);
+        ++position;
+    }
+    if (replaced != 0)
+    {
+        for (; position != last; ++position)
+        {
+            *out++ = static_cast<value_type>(*position);
+        }
+    }
+    return {std::move(out), replaced};
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <symbol_range<typename Container::value_type> R>
+constexpr void
+RegexConstexpr<Container, N, M>::profile(R &&input,
+                                         profile_type &visits) const noexcept
+{
+    if (_anchored.valid())
+    {
+        _anchored.profile(std::ranges::begin(input), std::ranges::end(input),
+                          visits);
+    }
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr void
+RegexConstexpr<Container, N, M>::relayout(const profile_type &visits) noexcept
+{
+    _anchored.relayout(visits);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr MemoryUsage RegexConstexpr<Container, N, M>::memory_usage() const
+    noexcept
+{
+    MemoryUsage usage = {};
+    _sm.memory_usage(usage);
+    _reverse_sm.memory_usage(usage);
+    usage.dfa_tables += _forward.memory_usage();
+    usage.dfa_tables += _reverse.memory_usage();
+    usage.dfa_tables += _anchored.memory_usage();
+    usage.dfa_overflows = _forward.overflowed() + _reverse.overflowed()
+                          + _anchored.overflowed();
+    usage.literals = _literals.memory_usage();
+
+    // The NFA runs when one of the automata a match may need is missing.
+    // Its sets grow on the heap to one entry per state, or per state and
+    // counter value, at most
+    const bool nfa = _valid && !_literal
+                     && (!_anchored.valid() || !_forward.valid()
+                         || !_reverse.valid());
+    const std::size_t sets =
+        _valid ? 2 * IndexSet::bytes(_sm._states.size())
+                     + 2 * IndexSet::bytes(_numbering.size())
+                     + 2 * _numbering.size() * sizeof(std::size_t)
+               : 0;
+    usage.scratch = {nfa ? sets : 0, sizeof(Scratch) + sets};
+
+    const std::size_t parts = usage.nfa_states.reserved
+                              + usage.nfa_transitions.reserved
+                              + usage.nfa_classes.reserved
+                              + usage.dfa_tables.reserved
+                              + usage.literals.reserved;
+    usage.other = {sizeof(*this) - parts, sizeof(*this) - parts};
+    return usage;
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+bool RegexConstexpr<Container, N, M>::save(std::ostream &os) const
+{
+    return _anchored.save(os);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+bool RegexConstexpr<Container, N, M>::load(std::istream &is)
+{
+    dfa_type loaded;
+    if (!loaded.load(is) || !loaded.isomorphic(_anchored))
+    {
+        return false;
+    }
+    _anchored = loaded;
+    return true;
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <std::size_t Lanes, symbol_batch<typename Container::value_type> B,
+          std::random_access_iterator Out>
+constexpr void
+RegexConstexpr<Container, N, M>::match_batch(const B &inputs, Out results,
+                                             MatchMode mode) const noexcept
+{
+    Scratch scratch;
+    match_batch<Lanes>(inputs, std::move(results), scratch, mode);
+}
+
+// A single walk over the table waits on every load before the next one, the
+// loads of independent inputs overlap when they are interleaved. A lane that
+// is done takes the next input of the batch, so long inputs do not hold the
+// others back
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <std::size_t Lanes, symbol_batch<typename Container::value_type> B,
+          std::random_access_iterator Out>
+constexpr void
+RegexConstexpr<Container, N, M>::match_batch(const B &inputs, Out results,
+                                             Scratch &scratch,
+                                             MatchMode mode) const noexcept
+{
+    static_assert(Lanes > 0, "A batch needs at least one lane");
+    if (mode == MatchMode::match_prefix)
+    {
+        mode = MatchMode::match_shortest;
+    }
+    if (!_valid || _literal || !_anchored.valid()
+        || mode == MatchMode::match_anywhere)
+    {
+        std::size_t index = 0;
+        for (const auto &input : inputs)
+        {
+            results[static_cast<std::iter_difference_t<Out>>(index++)] =
+                match(input, scratch, mode);
+        }
+        return;
+    }
+
+    using input_type = std::ranges::range_reference_t<const B>;
+    struct Lane
+    {
+        std::ranges::iterator_t<input_type> first;
+        std::ranges::sentinel_t<input_type> last;
+        typename dfa_type::state_type state;
+        std::size_t index;
+        bool accepted;
+    };
+    std::array<Lane, Lanes> lanes = {};
+    auto next_input = std::ranges::begin(inputs);
+    const auto last_input = std::ranges::end(inputs);
+    std::size_t n_started = 0;
+    // Loads the next input of the batch into the lane, if any is left
+    const auto start = [&](Lane &lane) -> bool
+    {
+        if (next_input == last_input)
+        {
+            return false;
+        }
+        input_type input = *next_input;
+        lane = Lane{std::ranges::begin(input), std::ranges::end(input),
+                    _anchored.initial(), n_started++, false};
+        ++next_input;
+        return true;
+    };
+
+    std::size_t n_lanes = 0;
+    while (n_lanes < Lanes && start(lanes[n_lanes]))
+    {
+        ++n_lanes;
+    }
+    while (n_lanes > 0)
+    {
+        for (std::size_t l = 0; l < n_lanes;)
+        {
+            // Same stop rules as run_anchored, one symbol per lane and round
+            Lane &lane = lanes[l];
+            bool done = true;
+            bool matched = false;
+            if (_anchored.dead(lane.state))
+            {
+                matched = mode != MatchMode::match_full && lane.accepted;
+            }
+            else if (_anchored.accepting(lane.state)
+                     && (mode == MatchMode::match_shortest
+                         || _anchored.always_accepting(lane.state)))
+            {
+                matched = true;
+            }
+            else if (lane.first == lane.last)
+            {
+                matched = _anchored.accepting(lane.state)
+                          || (mode != MatchMode::match_full && lane.accepted);
+            }
+            else
+            {
+                lane.accepted =
+                    lane.accepted || _anchored.accepting(lane.state);
+                lane.state = _anchored.next(
+                    lane.state, static_cast<value_type>(*lane.first));
+                ++lane.first;
+                done = false;
+            }
+
+            if (!done)
+            {
+                ++l;
+                continue;
+            }
+            results[static_cast<std::iter_difference_t<Out>>(lane.index)] =
+                matched;
+            if (start(lane))
+            {
+                ++l;
+            }
+            else
+            {
+                // The last lane takes this one's place and its turn
+                lane = lanes[--n_lanes];
+            }
+        }
+    }
+}
+
+// Returns the position where the first match ends, or with longest where
+// the longest of the leftmost matches ends, or npos
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It, class Sentinel>
+constexpr std::size_t
+RegexConstexpr<Container, N, M>::find_end(It first, Sentinel last, bool longest,
+                                          Scratch &scratch) const noexcept
+{
+    if (!_valid)
+    {
+        return npos;
+    }
+    if (_literal && !longest)
+    {
+        return _literals.find_end(std::move(first), last);
+    }
+    if (!_forward.valid())
+    {
+        return find_end_nfa(std::move(first), last, longest, scratch);
+    }
+    // The automaton follows the leftmost match once it found one, and dies
+    // when that match cannot grow any more
+    std::size_t end = npos;
+    typename dfa_type::state_type state = _forward.initial();
+    for (std::size_t i = 0;; ++i, ++first)
+    {
+        if (_forward.accepting(state))
+        {
+            end = i;
+            if (!longest)
+            {
+                return end;
+            }
+        }
+        if (first == last || _forward.dead(state))
+        {
+            return end;
+        }
+        state = _forward.next(state, static_cast<value_type>(*first));
+    }
+}
+
+// Unanchored simulation, the initial configuration is added back at every
+// position until a match is found. The configurations are grouped by the
+// position where their threads started, earliest first, and a configuration
+// belongs to the earliest thread that reaches it. A group that accepts drops
+// the ones after it, so that only the leftmost match is followed
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It, class Sentinel>
+constexpr std::size_t
+RegexConstexpr<Container, N, M>::find_end_nfa(It first, Sentinel last,
+                                              bool longest,
+                                              Scratch &scratch) const noexcept
+{
+    const std::size_t initial =
+        _numbering.index(configuration_type{_sm._initial_state, {}});
+    auto *current = &scratch.configurations[0];
+    auto *next = &scratch.configurations[1];
+    auto *current_groups = &scratch.groups[0];
+    auto *next_groups = &scratch.groups[1];
+    current->reset(_numbering.size());
+    next->reset(_numbering.size());
+    current_groups->clear();
+    // Ends a group with the configurations added since the last one, if any
+    const auto end_group =
+        [](const IndexSet &set, std::vector<std::size_t> &groups)
+    {
+        if (set.size() != (groups.empty() ? 0 : groups.back()))
+        {
+            groups.push_back(set.size());
+        }
+    };
+    current->insert(initial);
+    _sm.epsilon_closure(*current, _numbering);
+    end_group(*current, *current_groups);
+
+    bool found = false;
+    std::size_t end = npos;
+    for (std::size_t i = 0;; ++i, ++first)
+    {
+        for (std::size_t k = 0, group = 0; k < current->size(); ++k)
+        {
+            group += (k == (*current_groups)[group]) ? 1 : 0;
+            if (_sm._final_states.contains(_numbering.state((*current)[k])))
+            {
+                found = true;
+                end = i;
+                current->truncate((*current_groups)[group]);
+                current_groups->resize(group + 1);
+                break;
+            }
+        }
+        if ((end == i && !longest) || first == last || current->empty())
+        {
+            return end;
+        }
+
+        const value_type symbol = static_cast<value_type>(*first);
+        next->clear();
+        next_groups->clear();
+        std::size_t k = 0;
+        for (const std::size_t group_end : *current_groups)
+        {
+            // Each configuration is closed before the next one moves, so
+            // that what it reaches stays in its group
+            for (; k < group_end; ++k)
+            {
+                const configuration_type configuration =
+                    _numbering.configuration((*current)[k]);
+                _sm.for_each_move(
+                    configuration.state, symbol,
+                    [this, &configuration,
+                     next](const Transition<value_type> &transition)
+                    {
+                        const std::size_t from = next->size();
+                        if (next->insert(_numbering.index(configuration_type{
+                                transition.to, configuration.counters})))
+                        {
+                            _sm.epsilon_closure(*next, _numbering, from);
+                        }
+                    });
+            }
+            end_group(*next, *next_groups);
+        }
+        if (!found)
+        {
+            const std::size_t from = next->size();
+            if (next->insert(initial))
+            {
+                _sm.epsilon_closure(*next, _numbering, from);
+            }
+            end_group(*next, *next_groups);
+        }
+        std::swap(current, next);
+        std::swap(current_groups, next_groups);
+    }
+}
+
+// Runs the reversed machine backward from the end of the match, at offset
+// end, down to first and returns the leftmost offset where it accepts
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+template <class It>
+constexpr std::size_t RegexConstexpr<Container, N, M>::find_start_nfa(
+    It it, const It first, std::size_t end, Scratch &scratch) const noexcept
+{
+    auto *current = &scratch.configurations[0];
+    auto *next = &scratch.configurations[1];
+    current->reset(_numbering.size());
+    next->reset(_numbering.size());
+    current->insert(_numbering.index(
+        configuration_type{_reverse_sm._initial_state, {}}));
+    _reverse_sm.epsilon_closure(*current, _numbering);
+
+    std::size_t start = end;
+    for (std::size_t i = end;; --i)
+    {
+        for (const std::size_t configuration : *current)
+        {
+            if (_reverse_sm._final_states.contains(
+                    _numbering.state(configuration)))
+            {
+                start = i;
+                break;
+            }
+        }
+        if (it == first || current->empty())
+        {
+            return start;
+        }
+        next->clear();
+        step(_reverse_sm, _numbering, *current,
+             static_cast<value_type>(*--it), *next);
+        std::swap(current, next);
+    }
+}
+
+// Assuming a well-formed pattern
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr ConstexprVector<typename Container::value_type, N>
+RegexConstexpr<Container, N, M>::infix2postfix(
+    const Container &pattern, const VocabularyConstexpr<value_type> &voc)
+{
+    const TokenClassifier<value_type> classifier(voc);
+    return ast_type::from_infix(pattern, classifier).to_postfix(classifier);
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::state_machine_type
+RegexConstexpr<Container, N, M>::thompson_construction(
+    const ConstexprVector<typename Container::value_type, N> &rpn,
+    const VocabularyConstexpr<typename Container::value_type> &voc) noexcept
+{
+    const TokenClassifier<value_type> classifier(voc);
+    return thompson_construction(ast_type::from_postfix(rpn, classifier));
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::state_machine_type
+RegexConstexpr<Container, N, M>::thompson_construction(
+    const ast_type &ast) noexcept
+{
+    auto sm = state_machine_type();
+    if (!ast.valid())
+    {
+        sm._initial_state = sm.add_state();
+        return sm;
+    }
+    std::pair<StateID, StateID> regex = thompson_fragment(ast, ast.root(), sm);
+    sm._initial_state = regex.first;
+    sm._final_states.push_back(regex.second);
+    return sm;
+}
+
+// Returns the initial and the final state of the fragment of the subtree
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr std::pair<StateID, StateID>
+RegexConstexpr<Container, N, M>::thompson_fragment(
+    const ast_type &ast, std::size_t id, state_machine_type &sm) noexcept
+{
+    const AstNode<value_type> &node = ast.node(id);
+    switch (node.kind)
+    {
+    case NodeKind::node_concat:
+    {
+        std::pair<StateID, StateID> regex =
+            thompson_fragment(ast, node.first_child, sm);
+        for (std::size_t c = ast.node(node.first_child).next_sibling;
+             c != no_node; c = ast.node(c).next_sibling)
+        {
+            std::pair<StateID, StateID> next = thompson_fragment(ast, c, sm);
+            sm.add_epsilon_transition(regex.second, next.first);
+            regex.second = next.second;
+        }
+        return regex;
+    }
+    case NodeKind::node_or:
+    {
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        for (std::size_t c = node.first_child; c != no_node;
+             c = ast.node(c).next_sibling)
+        {
+            std::pair<StateID, StateID> regex = thompson_fragment(ast, c, sm);
+            sm.add_epsilon_transition(state_from, regex.first);
+            sm.add_epsilon_transition(regex.second, state_to);
+        }
+        return std::make_pair(state_from, state_to);
+    }
+    case NodeKind::node_any:
+    case NodeKind::node_one_or_more:
+    {
+        std::pair<StateID, StateID> regex =
+            thompson_fragment(ast, node.first_child, sm);
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        sm.add_epsilon_transition(state_from, regex.first);
+        sm.add_epsilon_transition(regex.second, state_to);
+        if (node.kind == NodeKind::node_any)
+        {
+            sm.add_epsilon_transition(state_from, state_to);
+        }
+        sm.add_epsilon_transition(regex.second, regex.first);
+        return std::make_pair(state_from, state_to);
+    }
+    case NodeKind::node_repeat:
+    {
+        std::pair<StateID, StateID> regex =
+            thompson_fragment(ast, node.first_child, sm);
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        std::size_t counter = sm.add_counter(node.bounds.min, node.bounds.max);
+        if (node.bounds.max != 0)
+        {
+            sm.add_counter_transition(state_from, regex.first, counter,
+                                      CounterAction::counter_reset);
+            sm.add_counter_transition(regex.second, regex.first, counter,
+                                      CounterAction::counter_loop);
+            sm.add_counter_transition(regex.second, state_to, counter,
+                                      CounterAction::counter_exit);
+        }
+        if (node.bounds.min == 0)
+        {
+            sm.add_epsilon_transition(state_from, state_to);
+        }
+        return std::make_pair(state_from, state_to);
+    }
+    case NodeKind::node_class:
+    {
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        sm.add_class_transition(state_from, state_to,
+                                sm.add_class(ast.char_class(node.char_class)));
+        return std::make_pair(state_from, state_to);
+    }
+    case NodeKind::node_symbol:
+    {
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        sm.add_transition(state_from, state_to, node.symbol);
+        return std::make_pair(state_from, state_to);
+    }
+    default: // Empty
+    {
+        StateID state_from = sm.add_state();
+        StateID state_to = sm.add_state();
+        sm.add_epsilon_transition(state_from, state_to);
+        return std::make_pair(state_from, state_to);
+    }
+    }
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::state_machine_type
+RegexConstexpr<Container, N, M>::glushkov_construction(
+    const ConstexprVector<typename Container::value_type, N> &rpn,
+    const VocabularyConstexpr<typename Container::value_type> &voc) noexcept
+{
+    const TokenClassifier<value_type> classifier(voc);
+    return glushkov_construction(ast_type::from_postfix(rpn, classifier));
+}
+
+// Builds the position automaton: every terminal symbol of the pattern
+// becomes a state and each transition enters the state of the symbol it reads,
+// so no epsilon transition is needed and the machine has exactly
+// positions + 1 states
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::state_machine_type
+RegexConstexpr<Container, N, M>::glushkov_construction(
+    const ast_type &ast) noexcept
+{
+    auto sm = state_machine_type();
+    ConstexprVector<value_type, N + 1> labels;
+    ConstexprVector<std::size_t, N + 1> label_classes;
+    labels.push_back(value_type());
+    label_classes.push_back(no_class);
+    const StateID initial_state = sm.add_state();
+    sm._initial_state = initial_state;
+    if (!ast.valid())
+    {
+        return sm;
+    }
+
+    const GlushkovFragment regex =
+        glushkov_fragment(ast, ast.root(), sm, labels, label_classes);
+    glushkov_follow(sm, labels, label_classes, initial_state, regex.first);
+    for (const auto &position : regex.last)
+    {
+        sm._final_states.push_back(position);
+    }
+    if (regex.nullable)
+    {
+        sm._final_states.push_back(initial_state);
+    }
+    return sm;
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr RegexConstexpr<Container, N, M>::GlushkovFragment
+RegexConstexpr<Container, N, M>::glushkov_fragment(
+    const ast_type &ast, std::size_t id, state_machine_type &sm,
+    ConstexprVector<value_type, N + 1> &labels,
+    ConstexprVector<std::size_t, N + 1> &label_classes) noexcept
+{
+    const AstNode<value_type> &node = ast.node(id);
+    GlushkovFragment regex = {false, ConstexprVector<StateID, N>(),
+                              ConstexprVector<StateID, N>()};
+    switch (node.kind)
+    {
+    case NodeKind::node_concat:
+    {
+        regex.nullable = true;
+        for (std::size_t c = node.first_child; c != no_node;
+             c = ast.node(c).next_sibling)
+        {
+            GlushkovFragment next =
+                glushkov_fragment(ast, c, sm, labels, label_classes);
+            for (const auto &position : regex.last)
+            {
+                glushkov_follow(sm, labels, label_classes, position,
+                                next.first);
+            }
+            if (regex.nullable)
+            {
+                glushkov_merge(regex.first, next.first);
+            }
+            if (next.nullable)
+            {
+                glushkov_merge(next.last, regex.last);
+            }
+            regex.last = next.last;
+            regex.nullable = regex.nullable && next.nullable;
+        }
+        return regex;
+    }
+    case NodeKind::node_or:
+        for (std::size_t c = node.first_child; c != no_node;
+             c = ast.node(c).next_sibling)
+        {
+            GlushkovFragment next =
+                glushkov_fragment(ast, c, sm, labels, label_classes);
+            regex.nullable = regex.nullable || next.nullable;
+            glushkov_merge(regex.first, next.first);
+            glushkov_merge(regex.last, next.last);
+        }
+        return regex;
+    case NodeKind::node_any:
+    case NodeKind::node_one_or_more:
+        regex = glushkov_fragment(ast, node.first_child, sm, labels,
+                                  label_classes);
+        for (const auto &position : regex.last)
+        {
+            glushkov_follow(sm, labels, label_classes, position, regex.first);
+        }
+        regex.nullable =
+            regex.nullable || node.kind == NodeKind::node_any;
+        return regex;
+    case NodeKind::node_symbol:
+    case NodeKind::node_class:
+    {
+        StateID position = sm.add_state();
+        labels.push_back(node.symbol);
+        label_classes.push_back(
+            node.kind == NodeKind::node_class
+                ? sm.add_class(ast.char_class(node.char_class))
+                : no_class);
+        regex.first.push_back(position);
+        regex.last.push_back(position);
+        return regex;
+    }
+    default: // Empty, counted repetitions are built by Thompson's
+        regex.nullable = true;
+        return regex;
+    }
+}
+
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr void RegexConstexpr<Container, N, M>::glushkov_merge(
+    ConstexprVector<StateID, N> &into,
+    const ConstexprVector<StateID, N> &from) noexcept
+{
+    for (const auto &position : from)
+    {
+        if (!into.contains(position))
+        {
+            into.push_back(position);
+        }
+    }
+}
+
+// Adds a transition from a position to each of the positions that can
+// follow it, labeled with the symbol of the target
+template <class Container, std::size_t N, std::size_t M>
+#if __cplusplus > 201703L // C++ 20
+    requires std::default_initializable<Container>
+#endif
+constexpr void RegexConstexpr<Container, N, M>::glushkov_follow(
+    state_machine_type &sm, const ConstexprVector<value_type, N + 1> &labels,
+    const ConstexprVector<std::size_t, N + 1> &label_classes, StateID from,
+    const ConstexprVector<StateID, N> &to) noexcept
+{
+    for (const auto &position : to)
+    {
+        // Out of room, the caller builds Thompson's automaton instead
+        if (sm._transitions.size() == max_transitions)
+        {
+            return;
+        }
+        bool exists = false;
+        for (const auto &transition : sm._transitions)
+        {
+            if (transition.from == from && transition.to == position)
+            {
+                exists = true;
+                break;
+            }
+        }
+        if (exists)
+        {
+            continue;
+        }
+        if (label_classes[position] != no_class)
+        {
+            sm.add_class_transition(from, position, label_classes[position]);
+        }
+        else
+        {
+            sm.add_transition(from, position, labels[position]);
+        }
+    }
+}
+
+// Lazy range of the matches of a regex in an input. An iterator holds the
+// position where the search resumes and the last match, nothing else is kept
+template <class Regex, std::ranges::view V>
+    requires std::ranges::bidirectional_range<V>
+class MatchView : public std::ranges::view_interface<MatchView<Regex, V>>
+{
+  public:
+    using scratch_type = Regex::Scratch;
+    class iterator;
+    // Nothing matches without a regex
+    constexpr MatchView(const Regex *regex, V input,
+                        scratch_type *scratch) noexcept
+        : _regex(regex), _input(std::move(input)), _scratch(scratch)
+    {
+    }
+    constexpr iterator begin() const noexcept
+    {
+        iterator it(this);
+        it.search();
+        return it;
+    }
+    constexpr std::default_sentinel_t end() const noexcept
+    {
+        return std::default_sentinel;
+    }
+
+  private:
+    const Regex *_regex;
+    V _input;
+    // Working sets for the NFA, the regex sets up its own when null
+    scratch_type *_scratch;
+};
+
+template <class Regex, std::ranges::view V>
+    requires std::ranges::bidirectional_range<V>
+class MatchView<Regex, V>::iterator
+{
+  public:
+    using value_type = Match;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::input_iterator_tag;
+
+    constexpr iterator() noexcept = default;
+    constexpr const Match &operator*() const noexcept
+    {
+        return *_match;
+    }
+    constexpr iterator &operator++() noexcept
+    {
+        search();
+        return *this;
+    }
+    constexpr void operator++(int) noexcept
+    {
+        search();
+    }
+    constexpr bool operator==(std::default_sentinel_t) const noexcept
+    {
+        return !_match.has_value();
+    }
+
+  private:
+    friend class MatchView;
+    const MatchView *_view = nullptr;
+    std::ranges::iterator_t<const V> _position = {};
+    std::size_t _offset = 0;
+    std::optional<Match> _match = std::nullopt;
+    // Past the end of the input, after an empty match at its end
+    bool _exhausted = false;
+
+    constexpr explicit iterator(const MatchView *view) noexcept
+        : _view(view), _position(std::ranges::begin(view->_input))
+    {
+    }
+    // Finds the next match and moves past it
+    constexpr void search() noexcept
+    {
+        if (_exhausted || _view->_regex == nullptr)
+        {
+            _match = std::nullopt;
+            return;
+        }
+        const auto last = std::ranges::end(_view->_input);
+        const std::ranges::subrange rest(_position, last);
+        const std::optional<Match> found =
+            (_view->_scratch == nullptr)
+                ? _view->_regex->find(rest)
+                : _view->_regex->find(rest, *_view->_scratch);
+        if (!found)
+        {
+            _match = std::nullopt;
+            return;
+        }
+        _match = Match{_offset + found->begin, _offset + found->end};
+        const std::size_t skip =
+            found->end + (found->begin == found->end ? 1 : 0);
+        const auto left = std::ranges::advance(
+            _position, static_cast<std::ranges::range_difference_t<V>>(skip),
+            last);
+        _offset += skip;
+        _exhausted = left != 0;
+    }
+};
+
 template <class T>
 std::ostream &operator<<(std::ostream &os, const Transition<T>& t)
 {
@@ -506,6 +2558,10 @@ std::ostream &operator<<(std::ostream &os, const Transition<T>& t)
     {
         os << "ε";
     }
+    else if (t.char_class != no_class)
+    {
+        os << "class " << t.char_class;
+    }
     else
     {
         os << t.symbol;
@@ -24,11 +24,28 @@
  *
  */
 
+#include <regez/char_class.hpp>
+#include <regez/incremental_matcher.hpp>
+#include <regez/lexer.hpp>
 #include <regez/regez.hpp>
+#include <list>
+#include <cstdint>
+#include <ranges>
 #include <regez/regez_constexpr.hpp>
+#include <span>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <valfuzz/valfuzz.hpp>
 
+// Identifier drawn from a large vocabulary of events, not a character type
+struct EventId
+{
+    std::uint32_t id;
+    constexpr auto operator<=>(const EventId &) const noexcept = default;
+};
+
 TEST(regez_constructor, "regez constructor")
 {
     regez::Vocabulary<char> vocab = regez::Vocabulary<char>()
@@ -138,9 +155,1383 @@ TEST(regez_thompson_constexpr_test, "regez thompson construction constexpr")
     constexpr regez::ConstexprVector<char, 3> postfix =
         regez::RegexConstexpr<std::string, 3>::infix2postfix(std::string("a|b"),
                                                              vocab);
-    constexpr regez::StateMachine<char, regez::pow(2, 3)> sm =
+    constexpr auto sm =
         regez::RegexConstexpr<std::string, 3>::thompson_construction(postfix,
                                                                      vocab);
     static_assert(sm._states.size() == 6);
 }
+
+TEST(regez_char_class_constexpr_test, "regez character class construction")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::ConstexprVector<char, 12> postfix =
+        regez::RegexConstexpr<std::string, 12>::infix2postfix(
+            std::string("[a-zA-Z0-9_]"), vocab);
+    constexpr auto sm =
+        regez::RegexConstexpr<std::string, 12>::thompson_construction(postfix,
+                                                                      vocab);
+    static_assert(sm._states.size() == 2);
+    static_assert(sm._transitions.size() == 1);
+    static_assert(sm._classes.size() == 1);
+    static_assert(sm._classes[0].size() == 4);
+}
+
+TEST(regez_glushkov_constexpr_test, "regez glushkov construction constexpr")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::ConstexprVector<char, 8> postfix =
+        regez::RegexConstexpr<std::string, 8>::infix2postfix(
+            std::string("(a|b)*.c"), vocab);
+    constexpr auto sm =
+        regez::RegexConstexpr<std::string, 8>::glushkov_construction(postfix,
+                                                                     vocab);
+    static_assert(sm._states.size() == 4);
+    static_assert(sm._transitions.size() == 9);
+    static_assert(sm._final_states.size() == 1);
+    for (const auto &t : sm._transitions)
+    {
+        ASSERT(!t.epsilon);
+    }
+}
+#endif
+
+TEST(regez_match_glushkov_constexpr, "regez match glushkov constexpr")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::RegexConstexpr<std::string, 8> thompson(
+        std::string("(a|b)*.c"), vocab, regez::Construction::thompson);
+    constexpr regez::RegexConstexpr<std::string, 8> glushkov(
+        std::string("(a|b)*.c"), vocab, regez::Construction::glushkov);
+    static_assert(thompson.match_nfa<4>(std::string("abac")));
+    static_assert(glushkov.match_nfa<4>(std::string("abac")));
+    static_assert(glushkov.match_nfa<1>(std::string("c")));
+    static_assert(!glushkov.match_nfa<3>(std::string("aba")));
+    static_assert(!glushkov.match_nfa<3>(std::string("acc")));
+
+    constexpr regez::RegexConstexpr<std::string, 4> escaped(
+        std::string("a.\\."), vocab, regez::Construction::glushkov);
+    static_assert(escaped.match_nfa<2>(std::string("a.")));
+    static_assert(!escaped.match_nfa<2>(std::string("ab")));
+
+    // Follow sets that do not fit in the transitions of the regex get
+    // Thompson's automaton instead, the quadratic bound always fits
+    std::string stars("a*");
+    for (char c = 'b'; c <= 'x'; ++c)
+    {
+        stars += {'.', c, '*'};
+    }
+    const regez::RegexConstexpr<std::string, 72> crowded(
+        stars, vocab, regez::Construction::glushkov);
+    const regez::RegexConstexpr<std::string, 72,
+                                regez::glushkov_transitions(72)>
+        roomy(stars, vocab, regez::Construction::glushkov);
+    ASSERT(crowded.match(std::string("abbx")));
+    ASSERT(!crowded.match(std::string("ba")));
+    ASSERT(roomy.match(std::string("abbx")));
+    ASSERT(!roomy.match(std::string("ba")));
+#ifdef REGEZ_DEBUG
+    ASSERT(crowded._construction == regez::Construction::thompson);
+    ASSERT(roomy._construction == regez::Construction::glushkov);
+#endif
+}
+
+TEST(regez_match_counted_repetition_constexpr,
+     "regez match counted repetition constexpr")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\', '{', '}', ','});
+    constexpr regez::RegexConstexpr<std::string, 6> between(
+        std::string("a{2,3}"), vocab);
+    static_assert(!between.match_nfa<1>(std::string("a")));
+    static_assert(between.match_nfa<2>(std::string("aa")));
+    static_assert(between.match_nfa<3>(std::string("aaa")));
+    static_assert(!between.match_nfa<4>(std::string("aaaa")));
+
+    constexpr regez::RegexConstexpr<std::string, 7> at_least(
+        std::string("a{2,}.b"), vocab);
+    static_assert(!at_least.match_nfa<2>(std::string("ab")));
+    static_assert(at_least.match_nfa<6>(std::string("aaaaab")));
+
+    constexpr regez::RegexConstexpr<std::string, 6> at_most(
+        std::string("a{,2}"), vocab);
+    static_assert(at_most.match_nfa<1>(std::string("")));
+    static_assert(!at_most.match_nfa<3>(std::string("aaa")));
+
+    constexpr regez::RegexConstexpr<std::string, 14> nested(
+        std::string("(a|b.a){1,500}"), vocab, regez::Construction::glushkov);
+    static_assert(nested.match_nfa<5>(std::string("abaaa")));
+    static_assert(!nested.match_nfa<3>(std::string("abb")));
+
+    constexpr regez::RegexConstexpr<std::string, 8> large(
+        std::string("a{1,500}"), vocab);
+    static_assert(large.match_nfa<500>(std::string(500, 'a')));
+    static_assert(!large.match_nfa<501>(std::string(501, 'a')));
+
+    // A state is active once per value of its counter, up to the bound
+    const regez::RegexConstexpr<std::string, 14> ambiguous(
+        std::string("(a|a.a){1,500}"), vocab);
+    regez::RegexConstexpr<std::string, 14>::Scratch scratch;
+    ASSERT(ambiguous.valid());
+    ASSERT(ambiguous.match(std::string(200, 'a'), scratch));
+    ASSERT(ambiguous.match(std::string(1000, 'a'), scratch));
+    ASSERT(!ambiguous.match(std::string(1001, 'a'), scratch));
+    ASSERT((ambiguous.find(std::string(300, 'b') + std::string(300, 'a'),
+                           scratch)
+            == regez::Match{300, 600}));
+
+    // Nested counters take every combination of their values
+    static_assert(
+        regez::RegexConstexpr<std::string, 13>(std::string("(a{2,3}.b){2}"),
+                                               vocab)
+            .match(std::string("aabaaab")));
+    static_assert(
+        !regez::RegexConstexpr<std::string, 13>(std::string("(a{2,3}.b){2}"),
+                                                vocab)
+             .match(std::string("aabab")));
+    const regez::RegexConstexpr<std::string, 26> huge(
+        std::string("((a{1,999}){1,999}){1,999}"), vocab);
+    ASSERT(!huge.valid());
+    ASSERT(huge.engine() == regez::Engine::engine_none);
+    ASSERT(!huge.match(std::string("a")));
+
+    // Bounds that are not closed, not decimal or out of order do not parse
+    constexpr regez::TokenClassifier<char> classifier(vocab);
+    static_assert(!regez::Ast<char, 6>::from_infix(std::string("a{3,2}"),
+                                                   classifier)
+                       .valid());
+    static_assert(
+        !regez::Ast<char, 6>::from_infix(std::string("a{2"), classifier)
+             .valid());
+    static_assert(
+        !regez::Ast<char, 6>::from_infix(std::string("a{x}"), classifier)
+             .valid());
+    static_assert(
+        regez::Ast<char, 6>::from_infix(std::string("a{,}"), classifier)
+            .valid());
+}
+
+TEST(regez_char_class, "regez character class")
+{
+    constexpr regez::CharClass<char, 4> cls = []()
+    {
+        regez::CharClass<char, 4> c;
+        c.add_range('a', 'c');
+        c.add_range('e', 'g');
+        c.add('d');
+        c.add('0');
+        return c;
+    }();
+    static_assert(cls.size() == 2);
+    static_assert(cls[0].first == '0' && cls[1].first == 'a'
+                  && cls[1].second == 'g');
+    static_assert(cls.contains('d') && cls.contains('0'));
+    static_assert(!cls.contains('h'));
+
+    constexpr regez::CharClass<int, 4> tokens = []()
+    {
+        regez::CharClass<int, 4> c;
+        c.add_range(1000, 2000);
+        c.add(-7);
+        c.negate();
+        return c;
+    }();
+    static_assert(!tokens.contains(1500) && !tokens.contains(-7));
+    static_assert(tokens.contains(2001) && tokens.contains(0));
+}
+
+TEST(regez_match_char_class_constexpr, "regez match character class constexpr")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 13> word(
+        std::string("[a-zA-Z0-9_]+"), vocab);
+    static_assert(word.match_nfa<7>(std::string("abc_09Z")));
+    static_assert(!word.match_nfa<4>(std::string("ab-c")));
+
+    constexpr regez::RegexConstexpr<std::string, 16> glushkov(
+        std::string("[^0-9]*.[\\]-]"), vocab, regez::Construction::glushkov);
+    static_assert(glushkov.match_nfa<4>(std::string("ab-]")));
+    static_assert(glushkov.match_nfa<1>(std::string("-")));
+    static_assert(!glushkov.match_nfa<3>(std::string("a1]")));
+
+    // Members one token each, as many ranges as the pattern has room for
+    constexpr regez::RegexConstexpr<std::string, 16> odd(
+        std::string("[^13579bdfhjlnp]"), vocab);
+    static_assert(odd.match(std::string("2")));
+    static_assert(!odd.match(std::string("p")));
+    constexpr regez::RegexConstexpr<std::string, 16> letters(
+        std::string("[acegikmoqsuwy]+"), vocab);
+    static_assert(!letters.match(std::string("yawn")));
+    static_assert(letters.match(std::string("ywwa")));
+}
+
+TEST(regez_token_classifier, "regez token classifier")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::TokenClassifier<char> classifier(vocab);
+    static_assert(classifier.classify('|') == regez::Operators::op_or);
+    static_assert(classifier.classify('\\') == regez::Operators::op_escape);
+    static_assert(classifier.classify('a') == regez::Operators::_op_max);
+    static_assert(classifier.classify('[') == regez::Operators::_op_max);
+
+    constexpr regez::VocabularyConstexpr<int> tokens({-1, -2, -3, -4, -5, -6});
+    constexpr regez::TokenClassifier<int> int_classifier(tokens);
+    static_assert(int_classifier.classify(-3) == regez::Operators::op_any);
+    static_assert(int_classifier.classify(42) == regez::Operators::_op_max);
+}
+
+TEST(regez_ast_simplify, "regez syntax tree simplification")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::TokenClassifier<char> classifier(vocab);
+
+    // abc|abd -> ab(c|d) -> ab[cd]
+    constexpr auto prefixes = [classifier]()
+    {
+        auto ast = regez::Ast<char, 11>::from_infix(std::string("a.b.c|a.b.d"),
+                                                    classifier);
+        ast.simplify();
+        return ast;
+    }();
+    static_assert(prefixes.valid());
+    static_assert(prefixes.node(prefixes.root()).kind
+                  == regez::NodeKind::node_concat);
+    static_assert(prefixes.size() == 4);
+    static_assert(prefixes.has(regez::NodeKind::node_class));
+    static_assert(!prefixes.has(regez::NodeKind::node_or));
+
+    constexpr auto stars = [classifier]()
+    {
+        auto ast = regez::Ast<char, 8>::from_infix(std::string("((a*)*)+"),
+                                                   classifier);
+        ast.simplify();
+        return ast;
+    }();
+    static_assert(stars.size() == 2);
+    static_assert(stars.node(stars.root()).kind == regez::NodeKind::node_any);
+
+    constexpr auto implicit = regez::Ast<char, 6>::from_infix(
+        std::string("ab*c"), classifier);
+    static_assert(implicit.to_postfix(classifier).size() == 6);
+
+    // Parsing stops at the first error and leaves an invalid tree
+    static_assert(!regez::Ast<char, 4>::from_infix(std::string("a||b"),
+                                                   classifier)
+                       .valid());
+    static_assert(
+        !regez::Ast<char, 2>::from_infix(std::string("a\\"), classifier)
+             .valid());
+}
+
+TEST(regez_match_simplified_constexpr, "regez match simplified patterns")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::RegexConstexpr<std::string, 11> prefixes(
+        std::string("a.b.c|a.b.d"), vocab);
+    static_assert(prefixes.match_nfa<3>(std::string("abc")));
+    static_assert(prefixes.match_nfa<3>(std::string("abd")));
+    static_assert(!prefixes.match_nfa<3>(std::string("abe")));
+
+    constexpr regez::RegexConstexpr<std::string, 8> tails(
+        std::string("ab|a|abc"), vocab, regez::Construction::glushkov);
+    static_assert(tails.match_nfa<1>(std::string("a")));
+    static_assert(tails.match_nfa<3>(std::string("abc")));
+    static_assert(!tails.match_nfa<2>(std::string("ac")));
+
+    constexpr regez::RegexConstexpr<std::string, 8> stars(
+        std::string("((a*)*)+"), vocab);
+    static_assert(stars.match_nfa<1>(std::string("")));
+    static_assert(stars.match_nfa<3>(std::string("aaa")));
+}
+
+TEST(regez_literal_trie, "regez literal alternation trie")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::TokenClassifier<char> classifier(vocab);
+    constexpr auto trie = [classifier]()
+    {
+        regez::LiteralTrie<char, 22> t;
+        t.build(regez::Ast<char, 22>::from_infix(
+            std::string("GET|POST|PUT|DELETE|PU"), classifier));
+        return t;
+    }();
+    // Root, G-E-T, P-O-S-T, U-T, D-E-L-E-T-E
+    static_assert(trie.size() == 16);
+    static_assert(trie.match(std::string_view("PUT").begin(),
+                             std::string_view("PUT").end()));
+    static_assert(trie.match(std::string_view("PU").begin(),
+                             std::string_view("PU").end()));
+    static_assert(!trie.match(std::string_view("POS").begin(),
+                              std::string_view("POS").end()));
+
+    constexpr std::string_view text = "a GEPOST";
+    static_assert(trie.find_end(text.begin(), text.end()) == 8);
+
+    // Vectorized lookups at runtime
+    const std::string request = std::string(40, '-') + "xDELETE";
+    ASSERT(trie.find_end(request.begin(), request.end()) == request.size());
+    ASSERT(trie.find_end(request.begin(), request.end() - 1)
+           == trie.npos);
+
+    regez::LiteralTrie<char, 39> wide;
+    wide.build(regez::Ast<char, 39>::from_infix(
+        std::string("a|b|c|d|e|f|g|h|i|j|k|l|m|n|o|p|q|r|s|t"), classifier));
+    const std::string letter = "s";
+    ASSERT(wide.match(letter.begin(), letter.end()));
+    const std::string digit = "7";
+    ASSERT(!wide.match(digit.begin(), digit.end()));
+
+    constexpr regez::RegexConstexpr<std::string, 16> methods(
+        std::string("GET|POST|PUT"), vocab);
+    static_assert(methods.match_nfa<4>(std::string("POST")));
+    static_assert(!methods.match_nfa<4>(std::string("PUTS")));
+    constexpr regez::RegexConstexpr<std::string, 8> not_literal(
+        std::string("GET|P*"), vocab);
+    static_assert(not_literal.match_nfa<3>(std::string("PPP")));
+}
+
+TEST(regez_find_constexpr, "regez find match span constexpr")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\', '{', '}', ','});
+    constexpr regez::RegexConstexpr<std::string, 8> regex(
+        std::string("a.b*.c"), vocab);
+    static_assert(regex.find(std::string("xxabbcab"))
+                  == regez::Match{2, 6});
+    static_assert(regex.find(std::string("xac")) == regez::Match{1, 3});
+    static_assert(!regex.find(std::string("abbb")).has_value());
+
+    // The leftmost match wins, then the longest one from its start, even
+    // when another match ends before it
+    constexpr regez::RegexConstexpr<std::string, 8> alternation(
+        std::string("a*.b|c.d"), vocab);
+    static_assert(alternation.find(std::string("cdaaab"))
+                  == regez::Match{0, 2});
+    static_assert(alternation.find(std::string("xaaabd"))
+                  == regez::Match{1, 5});
+    constexpr regez::RegexConstexpr<std::string, 12> digits(
+        std::string("(0|1|2|3|4)+"), vocab);
+    static_assert(digits.find(std::string("pin 1234"))
+                  == regez::Match{4, 8});
+    constexpr regez::RegexConstexpr<std::string, 10> overlapping(
+        std::string("a.b.c.d|c+"), vocab);
+    static_assert(overlapping.find(std::string("xabcd"))
+                  == regez::Match{1, 5});
+    static_assert(overlapping.find(std::string("xabcce"))
+                  == regez::Match{3, 5});
+
+    // Literals end on the trie, which then takes the longest one from the
+    // leftmost start
+    constexpr regez::RegexConstexpr<std::string, 10> literals(
+        std::string("abc|bc|cd"), vocab);
+    static_assert(literals.find(std::string("xxabcd"))
+                  == regez::Match{2, 5});
+    constexpr regez::RegexConstexpr<std::string, 10> prefixes(
+        std::string("abcd|c|ab"), vocab);
+    static_assert(prefixes.find(std::string("xabcd"))
+                  == regez::Match{1, 5});
+    static_assert(prefixes.find(std::string("xabce"))
+                  == regez::Match{1, 3});
+
+    // Counters are simulated on the NFA
+    constexpr regez::RegexConstexpr<std::string, 8> counted(
+        std::string("a{2,3}.b"), vocab);
+    static_assert(counted.find(std::string("abaaaab"))
+                  == regez::Match{3, 7});
+    static_assert(!counted.find(std::string("abb")).has_value());
+    constexpr regez::RegexConstexpr<std::string, 12> counted_longest(
+        std::string("(a|b){1,3}|c"), vocab);
+    static_assert(counted_longest.find(std::string("cabba"))
+                  == regez::Match{0, 1});
+    static_assert(counted_longest.find(std::string("xabba"))
+                  == regez::Match{1, 4});
+
+    constexpr regez::RegexConstexpr<std::string, 4> nullable(
+        std::string("a*"), vocab);
+    static_assert(nullable.find(std::string("ba")) == regez::Match{0, 0});
+    static_assert(nullable.find(std::string("aab")) == regez::Match{0, 2});
+}
+
+#ifdef REGEZ_DEBUG
+TEST(regez_reverse_dfa_constexpr_test, "regez forward and reverse dfa")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::RegexConstexpr<std::string, 8> regex(
+        std::string("(a|b)*.c"), vocab);
+    static_assert(regex._forward.valid() && regex._reverse.valid());
+    // Below 'a', [ab], 'c' and above 'c'
+    static_assert(regex._forward.classes() == 4);
+    static_assert(regex._reverse_sm._states.size()
+                  == regex._sm._states.size() + 1);
+}
+#endif
+
+TEST(regez_match_range_constexpr, "regez match ranges without copying")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')', '\\'});
+    constexpr regez::RegexConstexpr<std::string, 8> regex(
+        std::string("(a|b)*.c"), vocab);
+    static_assert(regex.match(std::string_view("abbac")));
+    static_assert(!regex.match(std::string_view("abba")));
+    static_assert(regex.match(std::string_view("xabcx").substr(1, 3)));
+
+    constexpr std::array<char, 3> symbols = {'b', 'a', 'c'};
+    static_assert(regex.match(std::span<const char>(symbols)));
+    static_assert(regex.match(symbols | std::views::drop(1)));
+
+    // Non contiguous and single pass inputs
+    const std::list<char> list = {'a', 'a', 'c'};
+    ASSERT(regex.match(list));
+    const std::vector<int> codes = {97, 98, 99};
+    const auto to_char = [](int c) { return static_cast<char>(c); };
+    ASSERT(regex.match(codes | std::views::transform(to_char)));
+    ASSERT((regex.find(list) == regez::Match{0, 3}));
+    ASSERT(!regex.find(std::list<char>{'a', 'b'}).has_value());
+
+    constexpr regez::VocabularyConstexpr<int> tokens({-1, -2, -3, -4, -5, -6});
+    constexpr regez::RegexConstexpr<std::array<int, 4>, 4> numbers(
+        std::array<int, 4>{1, -2, 2, -3}, tokens);
+    constexpr std::array<int, 4> sequence = {1, 2, 2, 2};
+    static_assert(numbers.match(std::span<const int>(sequence)));
+    constexpr std::array<int, 4> text = {5, 1, 2, 7};
+    static_assert(numbers.find(std::span<const int>(text))
+                  == regez::Match{1, 3});
+}
+
+TEST(regez_match_modes_constexpr, "regez match modes")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 4> regex(std::string("a.b*"),
+                                                          vocab);
+    static_assert(regex.match(std::string_view("abb")));
+    static_assert(!regex.match(std::string_view("abbc")));
+    static_assert(regex.match(std::string_view("abbc"),
+                              regez::MatchMode::match_prefix));
+    static_assert(regex.match_end(std::string_view("abbc"),
+                                  regez::MatchMode::match_prefix)
+                  == 3);
+    static_assert(regex.match_end(std::string_view("abbc"),
+                                  regez::MatchMode::match_shortest)
+                  == 1);
+    static_assert(!regex.match(std::string_view("ba"),
+                               regez::MatchMode::match_prefix));
+    static_assert(regex.match(std::string_view("ba"),
+                              regez::MatchMode::match_anywhere));
+    static_assert(regex.match_end(std::string_view("xxab"),
+                                  regez::MatchMode::match_anywhere)
+                  == 3);
+
+    constexpr regez::RegexConstexpr<std::string, 6> counted(
+        std::string("a{2,3}"), vocab);
+    static_assert(!counted.match(std::string_view("aaaa")));
+    static_assert(counted.match_end(std::string_view("aaaa"),
+                                    regez::MatchMode::match_prefix)
+                  == 3);
+    static_assert(counted.match_end(std::string_view("aaaa"),
+                                    regez::MatchMode::match_shortest)
+                  == 2);
+
+    constexpr regez::RegexConstexpr<std::string, 8> literals(
+        std::string("GET|GETS"), vocab);
+    static_assert(literals.match_end(std::string_view("GETSX"),
+                                     regez::MatchMode::match_prefix)
+                  == 4);
+    static_assert(literals.match_end(std::string_view("GETSX"),
+                                     regez::MatchMode::match_shortest)
+                  == 3);
+
+    // Every engine stops reading once the answer is known
+    const std::string record = "a" + std::string(1000, 'x');
+    std::size_t reads = 0;
+    const auto counting = record
+                          | std::views::transform(
+                              [&reads](char c)
+                              {
+                                  ++reads;
+                                  return c;
+                              });
+    constexpr regez::RegexConstexpr<std::string, 11> any(
+        std::string("a.(b|[^b])*"), vocab);
+    ASSERT(any.match(counting));
+    ASSERT(reads == 1);
+    ASSERT((any.match_end(record, regez::MatchMode::match_full)
+            == record.size()));
+    reads = 0;
+    ASSERT(!regex.match(counting));
+    ASSERT(reads == 2);
+    reads = 0;
+    ASSERT(!counted.match(counting));
+    ASSERT(reads == 2);
+    reads = 0;
+    ASSERT(!literals.match(counting));
+    ASSERT(reads == 1);
+}
+
+TEST(regez_shared_program, "regez runtime regex shares its program")
+{
+    const regez::Vocabulary<char> vocab =
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_or, '|')
+            .set(regez::Operators::op_concat, '.')
+            .set(regez::Operators::op_any, '*')
+            .set(regez::Operators::op_one_or_more, '+')
+            .set(regez::Operators::op_open_group, '(')
+            .set(regez::Operators::op_close_group, ')')
+            .set(regez::Operators::op_escape, '\\')
+            .set(regez::Operators::op_open_repeat, '{')
+            .set(regez::Operators::op_close_repeat, '}')
+            .set(regez::Operators::op_repeat_sep, ',')
+            .set(regez::Operators::op_open_match, '[')
+            .set(regez::Operators::op_close_match, ']')
+            .set(regez::Operators::op_range, '-')
+            .set(regez::Operators::op_negate, '^');
+    const regez::Regex<std::string> regex(std::string("(a|b)*c"), vocab);
+    ASSERT(regex.valid());
+    ASSERT(regex.match(std::string_view("abac")));
+    ASSERT(!regex.match(std::string_view("abca")));
+
+    const regez::Regex<std::string> copy = regex;
+    ASSERT(copy.program() == regex.program());
+
+    auto context = copy.context();
+    ASSERT(copy.match(std::string_view("c"), context));
+    ASSERT(copy.match(std::string_view("bca"), context,
+                      regez::MatchMode::match_prefix));
+    ASSERT((copy.find(std::string_view("xxbcx"), context)
+            == regez::Match{2, 4}));
+    std::size_t n_matches = 0;
+    for (const regez::Match match :
+         copy.matches(std::string_view("acxbbc"), context))
+    {
+        ASSERT((n_matches != 0 || match == regez::Match{0, 2}));
+        ASSERT((n_matches != 1 || match == regez::Match{3, 6}));
+        ++n_matches;
+    }
+    ASSERT(n_matches == 2);
+    const std::array<std::string_view, 3> batch = {"ac", "cc", "bbc"};
+    std::array<bool, 3> results = {};
+    copy.match_batch(batch, results.begin(), context);
+    ASSERT((results == std::array<bool, 3>{true, false, true}));
+
+    // Counted repetitions run on the context's working sets
+    const regez::Regex<std::string> counted(std::string("a{2,3}"), vocab);
+    ASSERT(counted.match(std::string_view("aaa"), context));
+    ASSERT(!counted.match(std::string_view("aaaa"), context));
+    ASSERT((counted.find(std::string_view("baab"), context)
+            == regez::Match{1, 3}));
+
+    const regez::Regex<std::string, std::allocator<char>, 2> too_long(
+        std::string("abc"), vocab);
+    ASSERT(!too_long.valid());
+    ASSERT(!too_long.match(std::string_view("abc")));
+    ASSERT(too_long.program() == nullptr);
+    ASSERT(too_long.engine() == regez::Engine::engine_none);
+    auto too_long_context = too_long.context();
+    auto none = too_long.matches(std::string_view("abc"), too_long_context);
+    ASSERT(none.begin() == none.end());
+    // So are patterns that do not parse or do not fit once encoded
+    const regez::Regex<std::string> malformed(std::string("a||b"), vocab);
+    ASSERT(!malformed.valid());
+    ASSERT(!malformed.match(std::string_view("a")));
+    const regez::Regex<std::string, std::allocator<char>, 8> wide(
+        std::string("[^a]"), vocab, regez::Construction::thompson,
+        regez::Encoding::encoding_utf8);
+    ASSERT(!wide.valid());
+    ASSERT(!wide.match(std::string_view("b")));
+}
+
+TEST(regez_large_alphabet_constexpr, "regez match a large custom alphabet")
+{
+    // Operators take the first identifiers, events start at 100000
+    constexpr regez::VocabularyConstexpr<EventId> vocab(
+        {EventId{0}, EventId{1}, EventId{2}, EventId{3}, EventId{4},
+         EventId{5}, EventId{6}, EventId{7}, EventId{8}, EventId{9},
+         EventId{10}, EventId{11}, EventId{12}, EventId{13}});
+    constexpr EventId open = {4};
+    constexpr EventId close = {5};
+    constexpr EventId alternative = {0};
+    constexpr EventId one_or_more = {3};
+    // (e3|e1|e4|e0|e2)+e9
+    constexpr std::array<EventId, 13> pattern = {
+        open,        EventId{100003}, alternative, EventId{100001},
+        alternative, EventId{100004}, alternative, EventId{100000},
+        alternative, EventId{100002}, close,       one_or_more,
+        EventId{100009}};
+    constexpr regez::RegexConstexpr<std::array<EventId, 13>, 13> regex(
+        pattern, vocab);
+    constexpr std::array<EventId, 4> events = {
+        EventId{100002}, EventId{100000}, EventId{100004}, EventId{100009}};
+    static_assert(regex.match(events));
+    static_assert(!regex.match(events | std::views::drop(3)));
+    static_assert(!regex.match(std::array<EventId, 2>{EventId{100005},
+                                                      EventId{100009}}));
+    static_assert(regex.find(std::array<EventId, 4>{
+                      EventId{7}, EventId{100001}, EventId{100009},
+                      EventId{100001}})
+                  == regez::Match{1, 3});
+}
+
+TEST(regez_partial_vocabulary, "regez operators left out of the vocabulary")
+{
+    // Without an escape operator, the default symbol is a plain one
+    constexpr regez::VocabularyConstexpr<char> vocab(
+        {'|', '.', '*', '+', '(', ')'});
+    constexpr regez::RegexConstexpr<std::string, 5> zero(
+        std::string("a.\0.b", 5), vocab);
+    static_assert(zero.valid());
+    static_assert(zero.match(std::string("a\0b", 3)));
+    static_assert(!zero.match(std::string("ab")));
+
+    constexpr regez::VocabularyConstexpr<EventId> events(
+        {EventId{1}, EventId{2}, EventId{3}, EventId{4}, EventId{5},
+         EventId{6}});
+    constexpr std::array<EventId, 3> pattern = {EventId{100}, EventId{2},
+                                                EventId{0}};
+    constexpr regez::RegexConstexpr<std::array<EventId, 3>, 3> regex(pattern,
+                                                                     events);
+    static_assert(regex.valid());
+    static_assert(regex.match(std::array<EventId, 2>{EventId{100},
+                                                     EventId{0}}));
+    static_assert(!regex.match(std::array<EventId, 1>{EventId{100}}));
+
+    const regez::Regex<std::string> runtime(
+        std::string("a.\0", 3),
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_or, '|')
+            .set(regez::Operators::op_concat, '.'));
+    ASSERT(runtime.valid());
+    ASSERT(runtime.match(std::string("a\0", 2)));
+}
+
+#ifdef REGEZ_DEBUG
+TEST(regez_transition_index_test, "regez transitions indexed by state")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 17> regex(
+        std::string("(d|a|c|b|[x-z])+e"), vocab);
+    const auto &sm = regex._sm;
+    ASSERT(sm._indexed);
+    for (regez::StateID state = 0; state < sm._states.size(); ++state)
+    {
+        const std::size_t first = sm._first_transition[state];
+        const std::size_t last = sm._first_transition[state + 1];
+        for (std::size_t t = first; t < last; ++t)
+        {
+            const auto &transition = sm._transitions[t];
+            ASSERT(transition.from == state);
+            ASSERT(transition.epsilon
+                   == (t < sm._first_class_transition[state]));
+            if (t > sm._first_symbol_transition[state])
+            {
+                ASSERT(sm._transitions[t - 1].symbol <= transition.symbol);
+            }
+        }
+    }
+    static_assert(regex.match(std::string_view("dyxbe")));
+    static_assert(!regex.match(std::string_view("dwe")));
+}
+#endif
+
+TEST(regez_match_batch_constexpr, "regez match batches of inputs")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 8> regex(
+        std::string("(a|b)*c"), vocab);
+    // More inputs than lanes, of uneven lengths
+    constexpr std::array<std::string_view, 7> inputs = {
+        "abac", "", "c", "abababababc", "abca", "x", "bbbbbbbbbbbbbbbbbbbbc"};
+    constexpr auto batch = [](const auto &re, const auto &in,
+                              regez::MatchMode mode)
+    {
+        std::array<bool, 7> results = {};
+        re.template match_batch<3>(in, results.begin(), mode);
+        return results;
+    };
+    static_assert(batch(regex, inputs, regez::MatchMode::match_full)
+                  == std::array<bool, 7>{true, false, true, true, false,
+                                         false, true});
+    static_assert(batch(regex, inputs, regez::MatchMode::match_prefix)
+                  == std::array<bool, 7>{true, false, true, true, true, false,
+                                         true});
+
+    // Counted repetitions fall back to matching the inputs one by one
+    constexpr regez::RegexConstexpr<std::string, 6> counted(
+        std::string("a{2,3}"), vocab);
+    constexpr std::array<std::string_view, 7> counts = {
+        "aa", "a", "aaa", "aaaa", "", "ab", "aab"};
+    static_assert(batch(counted, counts, regez::MatchMode::match_full)
+                  == std::array<bool, 7>{true, false, true, false, false,
+                                         false, false});
+
+    const std::vector<std::string> records = {"ac", "bd", "abc", "cc"};
+    std::vector<bool> matched(records.size());
+    regex.match_batch<16>(records, matched.begin());
+    ASSERT((matched == std::vector<bool>{true, false, true, false}));
+}
+
+TEST(regez_profile_relayout, "regez profile guided state layout")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    using regex_type = regez::RegexConstexpr<std::string, 12>;
+    constexpr auto relaid = [](const regex_type &regex)
+    {
+        regex_type::profile_type visits = {};
+        regex.profile(std::string_view("abcbcbcbz"), visits);
+        regex_type copy = regex;
+        copy.relayout(visits);
+        return copy;
+    };
+    constexpr regex_type regex(std::string("a(b|c)*(z|y)"), vocab);
+    constexpr regex_type hot = relaid(regex);
+    static_assert(hot.match(std::string_view("abcbz")));
+    static_assert(hot.match(std::string_view("ay")));
+    static_assert(!hot.match(std::string_view("abc")));
+    static_assert(!hot.match(std::string_view("bz")));
+
+    regex_type::profile_type visits = {};
+    hot.profile(std::string_view("abcbcbcbz"), visits);
+    // The dead and initial states first, then by decreasing visits: the
+    // loop on b and c comes right after the initial state
+    ASSERT(visits[2] == 7);
+    for (std::size_t d = 3; d < visits.size(); ++d)
+    {
+        ASSERT(visits[d - 1] >= visits[d]);
+    }
+
+    std::ostringstream heatmap;
+    heatmap << hot.heatmap(visits);
+    ASSERT(heatmap.str().starts_with("flowchart LR\n"));
+    ASSERT(heatmap.str().find("1 --> |a| 3\n") != std::string::npos);
+    ASSERT(heatmap.str().find("class 2 heat4\n") != std::string::npos);
+
+    std::stringstream saved;
+    ASSERT(hot.save(saved));
+    regex_type loaded(std::string("a(b|c)*(z|y)"), vocab);
+    ASSERT(loaded.load(saved));
+    ASSERT(loaded.match(std::string_view("abcbz")));
+    saved.clear();
+    saved.seekg(0);
+    regex_type other(std::string("a(b|c)*z"), vocab);
+    ASSERT(!other.load(saved));
+    ASSERT(other.match(std::string_view("abz")));
+
+    // The byte map and the states accepting every input are rebuilt, not
+    // taken from the image
+    std::string image = saved.str();
+    std::array<std::uint64_t, 5> header = {};
+    image.copy(reinterpret_cast<char *>(header.data()), sizeof(header));
+    const std::size_t byte_map = sizeof(header) + header[4];
+    image.replace(byte_map, 256, 256, '\0');
+    image.replace(image.size() - header[3], header[3], header[3], '\1');
+    std::stringstream tampered(image);
+    regex_type reloaded(std::string("a(b|c)*(z|y)"), vocab);
+    ASSERT(reloaded.load(tampered));
+    ASSERT(reloaded.match(std::string_view("abcbz")));
+    ASSERT(!reloaded.match(std::string_view("abc")));
+    ASSERT(!reloaded.match(std::string_view("ayy")));
+}
+
+#ifdef REGEZ_DEBUG
+TEST(regez_compressed_dfa_test, "regez compressed dfa table")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr std::size_t n = 26;
+    using regex_type = regez::RegexConstexpr<std::string, n>;
+    constexpr regex_type regex(std::string("(GET|PUT|POST|HEAD)[a-z]*x"),
+                               vocab);
+    using dense_type = regez::Dfa<char, 2 * (2 * n + 2), 2 * n + 2,
+                                  regez::DfaLayout::dfa_dense>;
+    using compressed_type = regez::Dfa<char, 2 * (2 * n + 2), 2 * n + 2,
+                                       regez::DfaLayout::dfa_compressed>;
+    static_assert(sizeof(compressed_type) * 4 < sizeof(dense_type));
+
+    constexpr auto build = [](const auto &sm, bool unanchored)
+    {
+        std::pair<dense_type, compressed_type> dfas;
+        dfas.first.build(sm, unanchored);
+        dfas.second.build(sm, unanchored);
+        return dfas;
+    };
+    for (const bool unanchored : {false, true})
+    {
+        const auto dfas = build(regex._sm, unanchored);
+        ASSERT(dfas.first.valid());
+        ASSERT(dfas.second.valid());
+        ASSERT(dfas.first.size() == dfas.second.size());
+        for (std::size_t d = 0; d < dfas.first.size(); ++d)
+        {
+            for (std::size_t c = 0; c < dfas.first.classes(); ++c)
+            {
+                ASSERT(dfas.first._table.at(d, c)
+                       == dfas.second._table.at(d, c));
+            }
+        }
+    }
+}
+#endif
+
+TEST(regez_compressed_table_overflow, "regez compressed table that overflows")
+{
+    // Rows that differ from every other in each entry cannot be stored as
+    // the differences with another one, equal rows only store the first
+    using table_type = regez::CompressedTable<8, 8>;
+    constexpr auto fits = [](std::size_t shift)
+    {
+        table_type::rows_type rows = {};
+        for (std::size_t s = 0; s < 8; ++s)
+        {
+            for (std::size_t c = 0; c < 8; ++c)
+            {
+                rows[s * 8 + c] =
+                    static_cast<table_type::state_type>((s * shift + c) % 8);
+            }
+        }
+        table_type table;
+        return table.assign(rows, 8, 8);
+    };
+    static_assert(fits(0));
+    static_assert(!fits(1));
+
+    // A regex reports the automata it could not keep, the default layout
+    // keeps them all
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')'});
+    constexpr regez::RegexConstexpr<std::string, 8> regex(
+        std::string("(a|b)*.c"), vocab);
+    static_assert(regex.memory_usage().dfa_overflows == 0);
+    static_assert(regex.engine() == regez::Engine::engine_dfa);
+}
+
+TEST(regez_matches_constexpr, "regez lazy range of matches")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 4> regex(std::string("ab+"),
+                                                          vocab);
+    constexpr auto spans = [](const auto &re, std::string_view input)
+    {
+        std::array<regez::Match, 4> found = {};
+        std::size_t n = 0;
+        for (const regez::Match match : re.matches(input))
+        {
+            found[n++] = match;
+        }
+        return std::pair(found, n);
+    };
+    static_assert(spans(regex, "xabyabbbab")
+                  == std::pair(std::array<regez::Match, 4>{regez::Match{1, 3},
+                                                           regez::Match{4, 8},
+                                                           regez::Match{8, 10},
+                                                           regez::Match{}},
+                               std::size_t(3)));
+    static_assert(spans(regex, "xyz").second == 0);
+    // Each match is the longest from its start, the next search resumes
+    // after it
+    constexpr regez::RegexConstexpr<std::string, 8> digits(
+        std::string("(0|1|2)+"), vocab);
+    static_assert(spans(digits, "12 0 21x")
+                  == std::pair(std::array<regez::Match, 4>{regez::Match{0, 2},
+                                                           regez::Match{3, 4},
+                                                           regez::Match{5, 7},
+                                                           regez::Match{}},
+                               std::size_t(3)));
+
+    // Empty matches move one symbol forward, up to the end of the input
+    constexpr regez::RegexConstexpr<std::string, 2> any(std::string("a*"),
+                                                        vocab);
+    static_assert(spans(any, "aba").second == 4);
+    static_assert(spans(any, "baa")
+                  == std::pair(std::array<regez::Match, 4>{regez::Match{0, 0},
+                                                           regez::Match{1, 3},
+                                                           regez::Match{3, 3},
+                                                           regez::Match{}},
+                               std::size_t(3)));
+
+    // A match is only searched for when the iterator gets to it
+    std::size_t reads = 0;
+    const std::list<char> text = {'a', 'b', 'x', 'a', 'b', 'a', 'b'};
+    const auto counted = text
+                         | std::views::transform(
+                             [&reads](char c)
+                             {
+                                 ++reads;
+                                 return c;
+                             });
+    const auto view = regex.matches(counted);
+    auto it = view.begin();
+    ASSERT((*it == regez::Match{0, 2}));
+    // Read forward up to the symbol that ends it, then backward
+    const std::size_t first_reads = reads;
+    ASSERT(first_reads <= 5);
+    ++it;
+    ASSERT((*it == regez::Match{3, 5}));
+    ASSERT(reads > first_reads);
+
+    std::vector<regez::Match> first_two;
+    for (const regez::Match match :
+         regex.matches(std::string_view("abxabab")) | std::views::take(2))
+    {
+        first_two.push_back(match);
+    }
+    ASSERT((first_two == std::vector<regez::Match>{regez::Match{0, 2},
+                                                   regez::Match{3, 5}}));
+
+    constexpr regez::RegexConstexpr<std::string, 6> counted_regex(
+        std::string("b{2,3}"), vocab);
+    static_assert(spans(counted_regex, "bbbbbxbb").second == 3);
+}
+
+TEST(regez_replace_all_constexpr, "regez replace every match")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 4> regex(std::string("ab+"),
+                                                          vocab);
+    constexpr auto replace = [](const auto &re, std::string_view input,
+                                std::string_view replacement)
+    {
+        std::array<char, 16> buffer = {};
+        const auto result =
+            re.replace_all(input, replacement, buffer.begin());
+        return std::pair(
+            std::string(buffer.begin(), result.out), result.replaced);
+    };
+    static_assert(replace(regex, "xabyabbbab", "-")
+                  == std::pair(std::string("x-y--"), std::size_t(3)));
+    static_assert(replace(regex, "abab", "")
+                  == std::pair(std::string(), std::size_t(2)));
+    // Nothing is written without a match, the input is the result
+    static_assert(replace(regex, "xyz", "-")
+                  == std::pair(std::string(), std::size_t(0)));
+
+    // Empty matches are replaced too, each keeping the symbol after it
+    constexpr regez::RegexConstexpr<std::string, 2> any(std::string("a*"),
+                                                        vocab);
+    static_assert(replace(any, "bab", "X")
+                  == std::pair(std::string("XbXXbX"), std::size_t(4)));
+    static_assert(replace(any, "", "X")
+                  == std::pair(std::string("X"), std::size_t(1)));
+
+    // Any container, into any output iterator
+    constexpr regez::VocabularyConstexpr<EventId> events(
+        {EventId{0}, EventId{1}, EventId{2}, EventId{3}, EventId{4},
+         EventId{5}, EventId{6}, EventId{7}, EventId{8}, EventId{9},
+         EventId{10}, EventId{11}, EventId{12}, EventId{13}});
+    // e1 e2 as one identifier
+    const regez::RegexConstexpr<std::vector<EventId>, 3> retry(
+        std::vector<EventId>{EventId{100001}, EventId{1}, EventId{100002}},
+        events);
+    const std::list<EventId> log = {
+        EventId{100000}, EventId{100001}, EventId{100002}, EventId{100001},
+        EventId{100003}, EventId{100001}, EventId{100002}};
+    std::vector<EventId> collapsed;
+    const auto result =
+        retry.replace_all(log, std::array<EventId, 1>{EventId{100009}},
+                          std::back_inserter(collapsed));
+    ASSERT(result.replaced == 2);
+    ASSERT((collapsed == std::vector<EventId>{EventId{100000}, EventId{100009},
+                                              EventId{100001}, EventId{100003},
+                                              EventId{100009}}));
+
+    const regez::Regex<std::string> digit(
+        std::string("[0-9]"),
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_open_match, '[')
+            .set(regez::Operators::op_close_match, ']')
+            .set(regez::Operators::op_range, '-'));
+    auto context = digit.context();
+    std::string masked;
+    ASSERT(digit
+               .replace_all(std::string_view("pin 1234, code 56"),
+                            std::string_view("#"), std::back_inserter(masked),
+                            context)
+               .replaced
+           == 6);
+    ASSERT(masked == "pin ####, code ##");
+
+    // Each match is replaced whole, nothing of a secret is left
+    const regez::Vocabulary<char> redaction_vocab =
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_one_or_more, '+')
+            .set(regez::Operators::op_open_match, '[')
+            .set(regez::Operators::op_close_match, ']')
+            .set(regez::Operators::op_range, '-');
+    const regez::Regex<std::string> secret(std::string("secret[0-9]+"),
+                                           redaction_vocab);
+    std::string redacted;
+    ASSERT(secret
+               .replace_all(std::string_view("id secret1234 end"),
+                            std::string_view("<redacted>"),
+                            std::back_inserter(redacted), context)
+               .replaced
+           == 1);
+    ASSERT(redacted == "id <redacted> end");
+    const regez::Regex<std::string> number(std::string("[0-9]+"),
+                                           redaction_vocab);
+    std::string pin;
+    number.replace_all(std::string_view("pin 1234"), std::string_view("#"),
+                       std::back_inserter(pin), context);
+    ASSERT(pin == "pin #");
+
+    // An invalid regex writes the input through
+    const regez::Regex<std::string> invalid(std::string("[0-9"),
+                                            redaction_vocab);
+    ASSERT(!invalid.valid());
+    std::string copied;
+    ASSERT(invalid
+               .replace_all(std::string_view("pin 1234"),
+                            std::string_view("#"),
+                            std::back_inserter(copied), context)
+               .replaced
+           == 0);
+    ASSERT(copied == "pin 1234");
+}
+
+TEST(regez_incremental_matcher, "regez incremental matching after edits")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 7> regex(
+        std::string("[a-z]*x"), vocab);
+    regez::IncrementalMatcher matcher(regex, 16);
+    std::string text(1000, 'a');
+    text += 'x';
+    ASSERT(matcher.assign(text));
+    ASSERT(matcher.scanned() == text.size());
+
+    // The state is the same right after the edit, the next checkpoint ends
+    // the scan
+    text[500] = 'b';
+    ASSERT(matcher.edit(text, 500, 1, 1));
+    ASSERT(matcher.scanned() <= 2 * 16);
+    text.insert(10, "abc");
+    ASSERT(matcher.edit(text, 10, 0, 3));
+    ASSERT(matcher.scanned() <= 2 * 16);
+    text += "yx";
+    ASSERT(matcher.append(text));
+    ASSERT(matcher.scanned() == 2);
+    ASSERT(matcher.size() == text.size());
+    text[100] = '0';
+    ASSERT(!matcher.edit(text, 100, 1, 1));
+    text[100] = 'a';
+    ASSERT(matcher.edit(text, 100, 1, 1));
+
+    // A stream appended one symbol at a time still gets its checkpoints, an
+    // edit near its end reads little of it
+    regez::IncrementalMatcher streamed(regex, 16);
+    std::string stream;
+    for (std::size_t i = 0; i < 10000; ++i)
+    {
+        stream += (i % 7 == 0) ? 'x' : 'a';
+        streamed.append(stream);
+        ASSERT(streamed.scanned() == 1);
+    }
+    stream[9990] = 'b';
+    ASSERT(streamed.edit(stream, 9990, 1, 1) == regex.match(stream));
+    ASSERT(streamed.scanned() <= 2 * 16);
+
+    // Random edits agree with matching from the start
+    constexpr regez::RegexConstexpr<std::string, 16> pairs(
+        std::string("((a|b)(a|b))*abb"), vocab);
+    regez::IncrementalMatcher incremental(pairs, 8);
+    std::string sequence;
+    std::uint32_t seed = 12345;
+    const auto random = [&seed](std::uint32_t bound)
+    {
+        seed = seed * 1664525 + 1013904223;
+        return static_cast<std::size_t>((seed >> 8) % bound);
+    };
+    for (std::size_t i = 0; i < 301; ++i)
+    {
+        sequence += random(2) == 0 ? 'a' : 'b';
+    }
+    incremental.assign(sequence);
+    for (std::size_t step = 0; step < 200; ++step)
+    {
+        const std::size_t position = random(
+            static_cast<std::uint32_t>(sequence.size() + 1));
+        const std::size_t removed = std::min<std::size_t>(
+            random(3), sequence.size() - position);
+        const std::size_t inserted = random(3);
+        std::string replacement;
+        for (std::size_t i = 0; i < inserted; ++i)
+        {
+            replacement += random(2) == 0 ? 'a' : 'b';
+        }
+        sequence.replace(position, removed, replacement);
+        ASSERT(incremental.edit(sequence, position, removed, inserted)
+               == pairs.match(sequence));
+        if (step % 50 == 0)
+        {
+            sequence += "abb";
+            ASSERT(incremental.append(sequence) == pairs.match(sequence));
+        }
+    }
+
+    // Counted repetitions have no DFA and are matched again from the start
+    constexpr regez::RegexConstexpr<std::string, 6> counted(
+        std::string("a{2,3}"), vocab);
+    regez::IncrementalMatcher again(counted);
+    ASSERT(again.assign(std::string("aa")));
+    ASSERT(!again.append(std::string("aaaa")));
+}
+
+TEST(regez_lexer, "regez longest match tokenization")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    using lexer_type = regez::Lexer<std::string, 8, 6>;
+    enum
+    {
+        tk_if,
+        tk_else,
+        tk_name,
+        tk_number,
+        tk_blank,
+        tk_equal,
+    };
+    constexpr lexer_type lexer({{{std::string("if"), tk_if},
+                                 {std::string("else"), tk_else},
+                                 {std::string("[a-z]+"), tk_name},
+                                 {std::string("[0-9]+"), tk_number},
+                                 {std::string(" +"), tk_blank},
+                                 {std::string("==*"), tk_equal}}},
+                               vocab);
+    static_assert(lexer.valid());
+    // Keywords win over names of the same length, longer names win over
+    // keywords
+    static_assert(lexer.next(std::string_view("if x"))
+                  == regez::Token{tk_if, 0, 2});
+    static_assert(lexer.next(std::string_view("iffy"))
+                  == regez::Token{tk_name, 0, 4});
+    static_assert(lexer.next(std::string_view("==1"))
+                  == regez::Token{tk_equal, 0, 2});
+    static_assert(!lexer.next(std::string_view("#")).has_value());
+
+    std::vector<regez::Token> tokens;
+    const std::string_view input = "if x == 10 elsewhere";
+    ASSERT(lexer.tokenize(input, std::back_inserter(tokens)) == input.size());
+    const std::vector<regez::Token> expected = {
+        {tk_if, 0, 2},      {tk_blank, 2, 3},   {tk_name, 3, 4},
+        {tk_blank, 4, 5},   {tk_equal, 5, 7},   {tk_blank, 7, 8},
+        {tk_number, 8, 10}, {tk_blank, 10, 11}, {tk_name, 11, 20},
+    };
+    ASSERT(tokens == expected);
+
+    // Stops where no rule reads a token
+    tokens.clear();
+    ASSERT(lexer.tokenize(std::string_view("a = b;c"),
+                          std::back_inserter(tokens))
+           == 5);
+    ASSERT(tokens.size() == 5);
+
+    // Counted repetitions have no DFA
+    constexpr regez::Lexer<std::string, 8, 1> counted(
+        {{{std::string("a{2}"), 0}}}, vocab);
+    static_assert(!counted.valid());
+}
+
+TEST(regez_utf8_constexpr, "regez match utf-8 patterns on raw bytes")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    // A quantifier applies to the whole code point
+    constexpr regez::RegexConstexpr<std::string, 16> accents(
+        std::string("caf(é)+|né+"), vocab, regez::Construction::thompson,
+        regez::Encoding::encoding_utf8);
+    static_assert(accents.match(std::string_view("café")));
+    static_assert(accents.match(std::string_view("cafééé")));
+    static_assert(accents.match(std::string_view("néé")));
+    static_assert(!accents.match(std::string_view("n\xc3\xa9\xa9")));
+
+    // Ranges of code points of several lengths
+    constexpr regez::RegexConstexpr<std::string, 24> greek(
+        std::string("[a-zα-ω€-₿]+"), vocab, regez::Construction::glushkov,
+        regez::Encoding::encoding_utf8);
+    static_assert(greek.match(std::string_view("λόγος")) == false);
+    static_assert(greek.match(std::string_view("λογοσ")));
+    static_assert(greek.match(std::string_view("eur€₿")));
+    static_assert(!greek.match(std::string_view("λ\xce")));
+    static_assert(!greek.match(std::string_view("Ω")));
+    static_assert((greek.find(std::string_view("1 + α = 2"))
+                   == regez::Match{4, 6}));
+
+    // Negated classes read any other code point, surrogates excluded. The
+    // byte sequences of a class need a larger N than its length
+    const regez::Vocabulary<char> dynamic_vocab =
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_or, '|')
+            .set(regez::Operators::op_concat, '.')
+            .set(regez::Operators::op_any, '*')
+            .set(regez::Operators::op_open_match, '[')
+            .set(regez::Operators::op_close_match, ']')
+            .set(regez::Operators::op_range, '-')
+            .set(regez::Operators::op_negate, '^');
+    const regez::Regex<std::string> other(
+        std::string("[^a]"), dynamic_vocab, regez::Construction::thompson,
+        regez::Encoding::encoding_utf8);
+    ASSERT(other.match(std::string_view("b")));
+    ASSERT(other.match(std::string_view("\x7f")));
+    ASSERT(other.match(std::string_view("ÿ")));
+    ASSERT(other.match(std::string_view("\xe0\xa0\x80")));
+    ASSERT(other.match(std::string_view("\xef\xbf\xbf")));
+    ASSERT(other.match(std::string_view("😀")));
+    ASSERT(other.match(std::string_view("\xf4\x8f\xbf\xbf")));
+    ASSERT(!other.match(std::string_view("a")));
+    ASSERT(!other.match(std::string_view("\xed\xa0\x80")));
+    ASSERT(!other.match(std::string_view("\xc3")));
+    ASSERT(!other.match(std::string_view("\xc0\x80")));
+    ASSERT(!other.match(std::string_view("\xf4\x90\x80\x80")));
+    ASSERT(!other.match(std::string_view("ab")));
+    auto context = other.context();
+    bool every_code_point = true;
+    for (char32_t point = 0x80; point <= 0x10ffff; ++point)
+    {
+        const bool surrogate = point >= 0xd800 && point <= 0xdfff;
+        std::string encoded;
+        if (point < 0x800)
+        {
+            encoded = {static_cast<char>(0xc0 | point >> 6),
+                       static_cast<char>(0x80 | (point & 0x3f))};
+        }
+        else if (point < 0x10000)
+        {
+            encoded = {static_cast<char>(0xe0 | point >> 12),
+                       static_cast<char>(0x80 | (point >> 6 & 0x3f)),
+                       static_cast<char>(0x80 | (point & 0x3f))};
+        }
+        else
+        {
+            encoded = {static_cast<char>(0xf0 | point >> 18),
+                       static_cast<char>(0x80 | (point >> 12 & 0x3f)),
+                       static_cast<char>(0x80 | (point >> 6 & 0x3f)),
+                       static_cast<char>(0x80 | (point & 0x3f))};
+        }
+        every_code_point =
+            every_code_point && other.match(encoded, context) != surrogate;
+    }
+    ASSERT(every_code_point);
+
+    // A class with many members leaves as many gaps in its complement
+    const regez::Regex<std::string> sparse(
+        std::string("[^acegikmoqsuwyACEGIKMOQSUWY02468!#%&=]"), dynamic_vocab,
+        regez::Construction::thompson, regez::Encoding::encoding_utf8);
+    ASSERT(sparse.match(std::string_view("b")));
+    ASSERT(sparse.match(std::string_view("Z")));
+    ASSERT(sparse.match(std::string_view("é")));
+    ASSERT(sparse.match(std::string_view("😀")));
+    ASSERT(!sparse.match(std::string_view("y")));
+    ASSERT(!sparse.match(std::string_view("=")));
+
+    // Without the encoding the same pattern reads single bytes
+    const regez::Regex<std::string> bytes(std::string("[^a]"), dynamic_vocab);
+    ASSERT(bytes.match(std::string_view("\xc3")));
+    ASSERT(!bytes.match(std::string_view("ÿ")));
+
+    // Malformed patterns match nothing
+    constexpr regez::RegexConstexpr<std::string, 8> malformed(
+        std::string("a\xc3"), vocab, regez::Construction::thompson,
+        regez::Encoding::encoding_utf8);
+    static_assert(!malformed.match(std::string_view("a\xc3")));
+    static_assert(!malformed.valid() && accents.valid() && greek.valid());
+    // So do classes whose byte sequences need more than N nodes
+    constexpr regez::RegexConstexpr<std::string, 8> wide(
+        std::string("[^a]"), vocab, regez::Construction::thompson,
+        regez::Encoding::encoding_utf8);
+    static_assert(!wide.valid());
+    static_assert(!wide.match(std::string_view("b")));
+    const std::array<std::string_view, 2> batch = {"b", "é"};
+    std::array<bool, 2> results = {true, true};
+    wide.match_batch(batch, results.begin());
+    ASSERT((results == std::array<bool, 2>{false, false}));
+
+#ifdef REGEZ_DEBUG
+    static_assert(accents._anchored.valid());
+    ASSERT(other.program()->_anchored.valid());
 #endif
+}
+
+TEST(regez_memory_usage_constexpr, "regez memory usage of a compiled pattern")
+{
+    constexpr regez::VocabularyConstexpr<char> vocab({'|', '.', '*', '+', '(',
+                                                      ')', '\\', '{', '}', ',',
+                                                      '[', ']', '-', '^'});
+    constexpr regez::RegexConstexpr<std::string, 12> regex(
+        std::string("(a|b)*abb"), vocab);
+    constexpr regez::MemoryUsage usage = regex.memory_usage();
+    // The reserved parts make up the object, its content is much smaller
+    static_assert(usage.total().reserved
+                  == sizeof(regex) + usage.scratch.reserved);
+    static_assert(usage.total().used < usage.total().reserved / 4);
+    static_assert(usage.nfa_transitions.used > 0
+                  && usage.dfa_tables.used > 0);
+    static_assert(usage.total().used <= 4096, "budget of the pattern");
+    // Matching only runs the DFA, and the scratch it would set up is small
+    // enough for the stack
+    static_assert(usage.scratch.used == 0);
+    static_assert(sizeof(decltype(regex)::Scratch) <= 256);
+
+    constexpr regez::RegexConstexpr<std::string, 12> counted(
+        std::string("a{2,3}"), vocab);
+    static_assert(counted.memory_usage().scratch.used > 0);
+    // Counter configurations grow with the bound
+    constexpr regez::RegexConstexpr<std::string, 12> bounded(
+        std::string("a{1,500}"), vocab);
+    static_assert(bounded.memory_usage().scratch.used
+                  > 2 * 500 * sizeof(std::size_t));
+    static_assert(bounded.memory_usage().scratch.used
+                  <= bounded.memory_usage().scratch.reserved);
+    static_assert(counted.memory_usage().dfa_tables.used == 0);
+    constexpr regez::RegexConstexpr<std::string, 12> literals(
+        std::string("get|put"), vocab);
+    static_assert(literals.memory_usage().literals.used
+                  > regex.memory_usage().literals.used);
+    // Engines each of them runs
+    static_assert(regex.engine() == regez::Engine::engine_dfa);
+    static_assert(regex.engine(regez::MatchMode::match_anywhere)
+                  == regez::Engine::engine_dfa);
+    static_assert(counted.engine() == regez::Engine::engine_counting_nfa);
+    static_assert(literals.engine() == regez::Engine::engine_literal);
+
+    // The runtime regex reports the figures of its program
+    const regez::Vocabulary<char> dynamic_vocab =
+        regez::Vocabulary<char>()
+            .set(regez::Operators::op_or, '|')
+            .set(regez::Operators::op_concat, '.')
+            .set(regez::Operators::op_any, '*')
+            .set(regez::Operators::op_open_group, '(')
+            .set(regez::Operators::op_close_group, ')');
+    const regez::Regex<std::string, std::allocator<char>, 12> dynamic(
+        std::string("(a|b)*abb"), dynamic_vocab);
+    const regez::MemoryUsage dynamic_usage = dynamic.memory_usage();
+    ASSERT(dynamic_usage.dfa_tables == usage.dfa_tables);
+    ASSERT(dynamic_usage.nfa_states == usage.nfa_states);
+    ASSERT(dynamic_usage.other.reserved
+           == usage.other.reserved + sizeof(dynamic));
+}